@@ -1,5 +1,6 @@
 
 #include <algorithm>
+#include <cfloat>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
@@ -12,59 +13,131 @@ using namespace std;
 
 vector<ShortestPathResult> dijkstra(const Graph<OsmNode>& g, u64 start,
         const vector<u64>& endVec, ShortestPathDataStructure dataStructure) {
-    bool bin = dataStructure == BINARY_HEAP;
-
-    vector<ShortestPathResult> resultVec;
-    resultVec.reserve(endVec.size());
-    if (endVec.empty()) return resultVec;
-
-    BinaryHeap<u64> binHeap(8192);
-    unordered_map<u64, u64> binHeapNodes;
-    FibonacciHeap<u64> fibHeap;
-    unordered_map<u64, FHNode<u64>*> fibHeapNodes;
-
-    unordered_set<u64> endNodes;
-    unordered_map<u64, u64> predecessorMap;
-    unordered_map<u64, double> distanceMap;
-
-    endNodes.insert(endVec.begin(), endVec.end());
+    SearchWorkspace workspace;
+    return dijkstra(g, start, endVec, dataStructure, workspace);
+}
 
-    distanceMap[start] = 0;
-    
-    if (bin)
-        binHeapNodes[start] = binHeap.insert(start, 0);
-    else
-        fibHeapNodes[start] = fibHeap.insert(start, 0);
+// Settles nodes from start until every end has been settled, using heap
+// (with the node handles in handles)
+template <typename Heap, typename Handle>
+static void settleEnds(const Graph<OsmNode>& g, u32 startIdx, size_t remainingEnds,
+        SearchWorkspace& w, Heap& heap, vector<Handle>& handles) {
+    u32 generation = w.generation;
+    handles[startIdx] = heap.insert(startIdx, 0);
 
-    u64 next;
+    u32 next;
     double distance;
 
-    while (!((bin && binHeap.empty()) || (!bin && fibHeap.empty())) && !endNodes.empty()) {
-        next = bin ? binHeap.extractMin() : fibHeap.extractMin();
-        endNodes.erase(next);
+    while (!heap.empty() && remainingEnds != 0) {
+        next = heap.extractMin();
+        if (w.endIn[next] == generation) {
+            // Settled ends are marked with the previous generation
+            w.endIn[next] = generation - 1;
+            --remainingEnds;
+        }
 
-        for (const auto& edge : g.getEdges(next)) {
-            distance = distanceMap[next] + edge.second;
-            bool seen = distanceMap.count(edge.first) != 0;
+        for (u32 e = g.edgesBegin(next); e != g.edgesEnd(next); ++e) {
+            u32 target = g.getTarget(e);
+            distance = w.distances[next] + g.getWeight(e);
+            bool seen = w.reached(target);
 
-            if (!seen || distance < distanceMap[edge.first]) {
-                distanceMap[edge.first] = distance;
-                predecessorMap[edge.first] = next;
+            if (!seen || distance < w.distances[target]) {
+                w.reachedIn[target] = generation;
+                w.distances[target] = distance;
+                w.predecessors[target] = next;
 
                 if (seen) {
-                    bin ?
-                        binHeap.decreaseKey(binHeapNodes[edge.first], distance) :
-                        fibHeap.decreaseKey(fibHeapNodes[edge.first], distance);
+                    heap.decreaseKey(handles[target], distance);
                 }
                 else {
-                    if (bin)
-                        binHeapNodes[edge.first] = binHeap.insert(edge.first, distance);
-                    else
-                        fibHeapNodes[edge.first] = fibHeap.insert(edge.first, distance);
+                    handles[target] = heap.insert(target, distance);
                 }
             }
         }
     }
+}
+
+// Same as settleEnds, for heaps without decrease-key: improved nodes are
+// inserted again and entries whose key is above the node's distance are stale
+template <typename Heap>
+static void settleEndsLazy(const Graph<OsmNode>& g, u32 startIdx, size_t remainingEnds,
+        SearchWorkspace& w, Heap& heap) {
+    u32 generation = w.generation;
+    heap.insert(startIdx, 0);
+
+    while (!heap.empty() && remainingEnds != 0) {
+        auto [key, next] = heap.extractMin();
+        if (key > w.distances[next]) continue;
+
+        if (w.endIn[next] == generation) {
+            w.endIn[next] = generation - 1;
+            --remainingEnds;
+        }
+
+        for (u32 e = g.edgesBegin(next); e != g.edgesEnd(next); ++e) {
+            u32 target = g.getTarget(e);
+            double distance = key + g.getWeight(e);
+
+            if (!w.reached(target) || distance < w.distances[target]) {
+                w.reachedIn[target] = generation;
+                w.distances[target] = distance;
+                w.predecessors[target] = next;
+                heap.insert(target, distance);
+            }
+        }
+    }
+}
+
+// Settles nodes from start until every end in endVec is settled, leaving their
+// distances and the shortest path tree in the workspace
+static void searchEnds(const Graph<OsmNode>& g, u64 start, const vector<u64>& endVec,
+        ShortestPathDataStructure dataStructure, SearchWorkspace& w) {
+    w.start(g.numNodes());
+    size_t remainingEnds = 0;
+
+    for (u64 end : endVec) {
+        u32 idx = g.getIndex(end);
+        if (idx != Graph<OsmNode>::INVALID_INDEX && w.endIn[idx] != w.generation) {
+            w.endIn[idx] = w.generation;
+            ++remainingEnds;
+        }
+    }
+
+    u32 startIdx = g.getIndex(start);
+    w.reachedIn[startIdx] = w.generation;
+    w.distances[startIdx] = 0;
+    w.predecessors[startIdx] = SearchWorkspace::NO_PREDECESSOR;
+
+    switch (dataStructure) {
+        case FIBONACCI_HEAP:
+            settleEnds(g, startIdx, remainingEnds, w, w.fibHeap, w.fibHeapNodes);
+            break;
+        case BINARY_HEAP:
+            settleEnds(g, startIdx, remainingEnds, w, w.binHeap, w.heapIds);
+            break;
+        case RADIX_HEAP:
+            settleEnds(g, startIdx, remainingEnds, w, w.radixHeap, w.heapIds);
+            break;
+        case DIAL_BUCKETS:
+            settleEnds(g, startIdx, remainingEnds, w, w.dialQueue, w.heapIds);
+            break;
+        case QUATERNARY_HEAP:
+            settleEndsLazy(g, startIdx, remainingEnds, w, w.quaternaryHeap);
+            break;
+        case OCTONARY_HEAP:
+            settleEndsLazy(g, startIdx, remainingEnds, w, w.octonaryHeap);
+            break;
+    }
+}
+
+vector<ShortestPathResult> dijkstra(const Graph<OsmNode>& g, u64 start,
+        const vector<u64>& endVec, ShortestPathDataStructure dataStructure,
+        SearchWorkspace& workspace) {
+    vector<ShortestPathResult> resultVec;
+    resultVec.reserve(endVec.size());
+    if (endVec.empty()) return resultVec;
+
+    searchEnds(g, start, endVec, dataStructure, workspace);
 
     for (const auto& end : endVec) {
         ShortestPathResult result;
@@ -72,16 +145,11 @@ vector<ShortestPathResult> dijkstra(const Graph<OsmNode>& g, u64 start,
         if (end == start) {
             result.path.push_front(end);
             result.path.push_front(start);
+            result.distance = 0;
         }
-        else if (predecessorMap.count(end)) {
-            result.distance = distanceMap[end];
-
-            u64 node = end;
-            result.path.push_front(node);
-            while (predecessorMap.count(node)) {
-                node = predecessorMap[node];
-                result.path.push_front(node);
-            }
+        else {
+            result.path = searchPath(g, workspace, end);
+            if (!result.path.empty()) result.distance = workspace.distances[g.getIndex(end)];
         }
 
         resultVec.push_back(result);
@@ -90,52 +158,192 @@ vector<ShortestPathResult> dijkstra(const Graph<OsmNode>& g, u64 start,
     return resultVec;
 }
 
-pair<list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end) {
-    FibonacciHeap<u64> heap;
-    map<u64, FHNode<u64>*> fibHeapNodes;
-    map<u64, u64> predecessorMap;
-    map<u64, double> gScore;
+void dijkstraDistances(const Graph<OsmNode>& g, u64 start, const vector<u64>& endVec,
+        ShortestPathDataStructure dataStructure, SearchWorkspace& workspace,
+        vector<double>& distances) {
+    distances.clear();
+    if (endVec.empty()) return;
+
+    searchEnds(g, start, endVec, dataStructure, workspace);
+
+    for (u64 end : endVec) {
+        u32 endIdx = g.getIndex(end);
+
+        if (end == start) {
+            distances.push_back(0);
+        }
+        else if (endIdx != Graph<OsmNode>::INVALID_INDEX && workspace.reached(endIdx)) {
+            distances.push_back(workspace.distances[endIdx]);
+        }
+        else {
+            distances.push_back(DBL_MAX);
+        }
+    }
+}
+
+void batchedDijkstraDistances(const Graph<OsmNode>& g, const u64* sources, u32 numSources,
+        const vector<u64>& endVec, BatchWorkspace& workspace, vector<vector<double>>& distances) {
+    static const u32 LANES = BatchWorkspace::LANES;
+    BatchWorkspace& w = workspace;
+    w.start(g.numNodes());
+
+    for (u32 lane = 0; lane < numSources; ++lane) {
+        u32 idx = g.getIndex(sources[lane]);
+        w.reach(idx)[lane] = 0;
+        if (w.queuedKeys[idx] != 0) {
+            w.queuedKeys[idx] = 0;
+            w.heap.insert(idx, 0);
+        }
+    }
+
+    auto unknownLanes = [&](const double* d) {
+        u32 unknown = 0;
+        for (u32 lane = 0; lane < numSources; ++lane) {
+            if (d[lane] == DBL_MAX) ++unknown;
+        }
+        return unknown;
+    };
+
+    // Distances from a source to an end that are still unknown
+    vector<u32> ends;
+    size_t unknownEndLanes = 0;
+    for (u64 end : endVec) {
+        u32 idx = g.getIndex(end);
+        if (idx != Graph<OsmNode>::INVALID_INDEX && w.endIn[idx] != w.generation) {
+            w.endIn[idx] = w.generation;
+            ends.push_back(idx);
+            unknownEndLanes += unknownLanes(w.reach(idx));
+        }
+    }
+
+    // Largest distance from a source to an end, recomputed once every one is
+    // known and the queue passes the previous value
+    auto farthestEnd = [&] {
+        double farthest = 0;
+        for (u32 end : ends) {
+            const double* d = w.lanes.data() + (size_t) end * LANES;
+            for (u32 lane = 0; lane < numSources; ++lane) {
+                farthest = max(farthest, d[lane]);
+            }
+        }
+        return farthest;
+    };
+    double bound = 0;
+
+    while (!w.heap.empty()) {
+        auto [key, node] = w.heap.extractMin();
+        if (key != w.queuedKeys[node]) continue;
+        w.queuedKeys[node] = DBL_MAX;
+
+        // Every distance that can still improve is at least the smallest key,
+        // so the search stops once all ends are closer than that
+        if (unknownEndLanes == 0 && key >= bound) {
+            bound = farthestEnd();
+            if (key >= bound) break;
+        }
+
+        const double* from = w.lanes.data() + (size_t) node * LANES;
+        for (u32 e = g.edgesBegin(node); e != g.edgesEnd(node); ++e) {
+            u32 target = g.getTarget(e);
+            double weight = g.getWeight(e);
+            double* to = w.reach(target);
+            bool end = w.endIn[target] == w.generation;
+            u32 unknownBefore = end ? unknownLanes(to) : 0;
+
+            // Branch free, so that the lanes are updated together
+            double improved = DBL_MAX;
+            for (u32 lane = 0; lane < LANES; ++lane) {
+                double distance = from[lane] + weight;
+                bool better = distance < to[lane];
+                improved = min(improved, better ? distance : DBL_MAX);
+                to[lane] = better ? distance : to[lane];
+            }
 
-    Coordinates endCoords     = g.getNode(end).coordinates;
-    Coordinates currentCoords = g.getNode(start).coordinates;
+            if (end) unknownEndLanes -= unknownBefore - unknownLanes(to);
+            if (improved < w.queuedKeys[target]) {
+                w.queuedKeys[target] = improved;
+                w.heap.insert(target, improved);
+            }
+        }
+    }
+
+    distances.resize(numSources);
+    for (u32 lane = 0; lane < numSources; ++lane) {
+        distances[lane].resize(endVec.size());
+        for (size_t j = 0; j < endVec.size(); ++j) {
+            u32 idx = g.getIndex(endVec[j]);
+            bool reached = idx != Graph<OsmNode>::INVALID_INDEX && w.reached(idx);
+            distances[lane][j] = reached ? w.lanes[(size_t) idx * LANES + lane] : DBL_MAX;
+        }
+    }
+}
+
+list<u64> searchPath(const Graph<OsmNode>& g, const SearchWorkspace& workspace, u64 end) {
+    list<u64> path;
+    u32 node = g.getIndex(end);
+    if (node == Graph<OsmNode>::INVALID_INDEX || !workspace.reached(node)) return path;
+
+    path.push_front(end);
+    while (workspace.predecessors[node] != SearchWorkspace::NO_PREDECESSOR) {
+        node = workspace.predecessors[node];
+        path.push_front(g.getId(node));
+    }
+    return path;
+}
+
+// A* with heuristic(node) estimating the distance from node to end
+template <typename Heuristic>
+static pair<list<u64>, double> guidedSearch(const Graph<OsmNode>& g, u64 start, u64 end,
+        Heuristic heuristic, u32* settledNodes) {
+    static const u32 NO_PREDECESSOR = Graph<OsmNode>::INVALID_INDEX;
+    u32 n = g.numNodes();
+
+    FibonacciHeap<u32> heap;
+    vector<FHNode<u32>*> fibHeapNodes(n, nullptr);
+    vector<u32> predecessors(n, NO_PREDECESSOR);
+    vector<double> gScore(n, DBL_MAX);
+
+    u32 startIdx = g.getIndex(start), endIdx = g.getIndex(end);
+    u32 settled = 0;
 
     double distance = 0;
-    double fScore = distance + currentCoords.haversine(endCoords);
-    gScore[start] = distance;
-    fibHeapNodes[start] = heap.insert(start, fScore);
+    double fScore = distance + heuristic(startIdx);
+    gScore[startIdx] = distance;
+    fibHeapNodes[startIdx] = heap.insert(startIdx, fScore);
 
-    u64 min, neighbor;
+    u32 min, neighbor;
     double edgeLength;
     while (!heap.empty()) {
         min = heap.extractMin();
-        fibHeapNodes.erase(min);
+        fibHeapNodes[min] = nullptr;
+        ++settled;
 
         // Check if the destination node has been reached
-        if (min == end) {
-            u64 node = min;
+        if (min == endIdx) {
+            u32 node = min;
             list<u64> path;
-            path.push_front(node);
-            while (predecessorMap.count(node)) {
-                node = predecessorMap[node];
-                path.push_front(node);
+            path.push_front(g.getId(node));
+            while (predecessors[node] != NO_PREDECESSOR) {
+                node = predecessors[node];
+                path.push_front(g.getId(node));
             }
 
-            return make_pair(path, distance);
+            if (settledNodes) *settledNodes = settled;
+            return make_pair(path, gScore[endIdx]);
         }
 
-        for (const pair<u64, double>& edge : g.getEdges(min)) {
-            neighbor   = edge.first;
-            edgeLength = edge.second;
+        for (u32 e = g.edgesBegin(min); e != g.edgesEnd(min); ++e) {
+            neighbor   = g.getTarget(e);
+            edgeLength = g.getWeight(e);
             distance   = gScore[min] + edgeLength;
 
-            bool seen = gScore.count(neighbor) != 0;
+            bool seen = gScore[neighbor] != DBL_MAX;
             if (!seen || distance < gScore[neighbor]) {
-                currentCoords = g.getNode(neighbor).coordinates;
-                fScore = distance + currentCoords.haversine(endCoords);
+                fScore = distance + heuristic(neighbor);
 
-                predecessorMap[neighbor] = min;
+                predecessors[neighbor] = min;
                 gScore[neighbor] = distance;
-                if (seen) {
+                if (fibHeapNodes[neighbor]) {
                     heap.decreaseKey(fibHeapNodes[neighbor], fScore);
                 }
                 else {
@@ -146,16 +354,146 @@ pair<list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end)
     }
 
     // Failed to find a path between start and end
+    if (settledNodes) *settledNodes = settled;
     return make_pair<list<u64>, double>({}, 0);
 }
 
-std::pair<std::list<u64>, double> simpleMemoryBoundedAStarSearch(Graph<OsmNode> g, u64 start, u64 end, int maxSize) {
+pair<list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end,
+        double heuristicScale, u32* settledNodes) {
+    Coordinates endCoords = g.getNode(g.getIndex(end)).coordinates;
+
+    return guidedSearch(g, start, end, [&](u32 node) {
+        return heuristicScale * g.getNode(node).coordinates.haversine(endCoords);
+    }, settledNodes);
+}
+
+pair<list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end,
+        const Landmarks& landmarks, u32* settledNodes) {
+    u32 endIdx = g.getIndex(end);
+
+    return guidedSearch(g, start, end, [&](u32 node) {
+        return landmarks.lowerBound(node, endIdx);
+    }, settledNodes);
+}
+
+// Bidirectional search with potential(node) added to forward keys and
+// subtracted from backward keys. With a consistent potential, the sum of the
+// two smallest keys bounds every path through an unsettled node.
+template <typename Potential>
+static pair<list<u64>, double> bidirectionalSearch(const Graph<OsmNode>& g,
+        const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, Potential potential,
+        u32* settledNodes) {
+    static const u32 NO_NODE = Graph<OsmNode>::INVALID_INDEX;
+    u32 n = g.numNodes();
+
+    FibonacciHeap<u32> heaps[2];
+    vector<FHNode<u32>*> heapNodes[2] = {vector<FHNode<u32>*>(n, nullptr), vector<FHNode<u32>*>(n, nullptr)};
+    vector<u32> parents[2] = {vector<u32>(n, NO_NODE), vector<u32>(n, NO_NODE)};
+    vector<double> distances[2] = {vector<double>(n, DBL_MAX), vector<double>(n, DBL_MAX)};
+
+    u32 startIdx = g.getIndex(start), endIdx = g.getIndex(end);
+    u32 settled = 0;
+
+    distances[0][startIdx] = 0;
+    heapNodes[0][startIdx] = heaps[0].insert(startIdx, potential(startIdx));
+    distances[1][endIdx] = 0;
+    heapNodes[1][endIdx] = heaps[1].insert(endIdx, -potential(endIdx));
+
+    double best = startIdx == endIdx ? 0 : DBL_MAX;
+    u32 meeting = startIdx == endIdx ? startIdx : NO_NODE;
+
+    while (!heaps[0].empty() && !heaps[1].empty()) {
+        if (heaps[0].getMinKey() + heaps[1].getMinKey() >= best) break;
+
+        // Expands the side with the smaller heap, which balances the work
+        // when one end is in a dead end or behind one-way streets
+        int side = heaps[0].getSize() <= heaps[1].getSize() ? 0 : 1;
+        double sign = side == 0 ? 1 : -1;
+
+        u32 node = heaps[side].extractMin();
+        heapNodes[side][node] = nullptr;
+        ++settled;
+
+        u32 begin = side == 0 ? g.edgesBegin(node) : reverse.edgesBegin(node);
+        u32 endEdge = side == 0 ? g.edgesEnd(node) : reverse.edgesEnd(node);
+
+        for (u32 e = begin; e != endEdge; ++e) {
+            u32 neighbor = side == 0 ? g.getTarget(e) : reverse.getTarget(e);
+            double distance = distances[side][node] +
+                (side == 0 ? g.getWeight(e) : reverse.getWeight(e));
+
+            if (distance < distances[side][neighbor]) {
+                distances[side][neighbor] = distance;
+                parents[side][neighbor] = node;
+
+                double key = distance + sign * potential(neighbor);
+                if (heapNodes[side][neighbor]) {
+                    heaps[side].decreaseKey(heapNodes[side][neighbor], key);
+                }
+                else {
+                    heapNodes[side][neighbor] = heaps[side].insert(neighbor, key);
+                }
+            }
+
+            // Only the tentative distances of the other side are needed, so a
+            // path is recorded as soon as both searches have reached a node
+            double other = distances[1 - side][neighbor];
+            if (other != DBL_MAX && distances[side][neighbor] + other < best) {
+                best = distances[side][neighbor] + other;
+                meeting = neighbor;
+            }
+        }
+    }
+
+    if (settledNodes) *settledNodes = settled;
+
+    // Failed to find a path between start and end
+    if (meeting == NO_NODE) return make_pair<list<u64>, double>({}, 0);
+
+    list<u64> path;
+    for (u32 node = meeting; node != NO_NODE; node = parents[0][node]) {
+        path.push_front(g.getId(node));
+    }
+    for (u32 node = parents[1][meeting]; node != NO_NODE; node = parents[1][node]) {
+        path.push_back(g.getId(node));
+    }
+    return make_pair(path, best);
+}
+
+pair<list<u64>, double> bidirectionalDijkstra(const Graph<OsmNode>& g,
+        const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, u32* settledNodes) {
+    return bidirectionalSearch(g, reverse, start, end, [](u32) { return 0.0; }, settledNodes);
+}
+
+pair<list<u64>, double> bidirectionalAStarSearch(const Graph<OsmNode>& g,
+        const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, double heuristicScale,
+        u32* settledNodes) {
+    Coordinates startCoords = g.getNode(g.getIndex(start)).coordinates;
+    Coordinates endCoords = g.getNode(g.getIndex(end)).coordinates;
+
+    return bidirectionalSearch(g, reverse, start, end, [&](u32 node) {
+        const Coordinates& coords = g.getNode(node).coordinates;
+        return heuristicScale * (coords.haversine(endCoords) - coords.haversine(startCoords)) / 2;
+    }, settledNodes);
+}
+
+pair<list<u64>, double> bidirectionalAStarSearch(const Graph<OsmNode>& g,
+        const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, const Landmarks& landmarks,
+        u32* settledNodes) {
+    u32 startIdx = g.getIndex(start), endIdx = g.getIndex(end);
+
+    return bidirectionalSearch(g, reverse, start, end, [&](u32 node) {
+        return (landmarks.lowerBound(node, endIdx) - landmarks.lowerBound(startIdx, node)) / 2;
+    }, settledNodes);
+}
+
+std::pair<std::list<u64>, double> simpleMemoryBoundedAStarSearch(const Graph<OsmNode>& g, u64 start, u64 end, int maxSize) {
     FibonacciHeap<u64> heap;
     map<u64, u64> predecessorMap;
     map<u64, double> currentCostMap;
 
-    Coordinates endCoords     = g.getNode(end).coordinates;
-    Coordinates currentCoords = g.getNode(start).coordinates;
+    Coordinates endCoords     = g.getNode(g.getIndex(end)).coordinates;
+    Coordinates currentCoords = g.getNode(g.getIndex(start)).coordinates;
 
     double distance = 0;
     double estimate = currentCoords.haversine(endCoords);
@@ -166,14 +504,14 @@ std::pair<std::list<u64>, double> simpleMemoryBoundedAStarSearch(Graph<OsmNode>
     heap.insert(start, totalDistance);
 
     u64 min, nextNode, max;
+    u32 minIdx;
     double edgeLength, maxF;
-    list<pair<u64, double>> edges;
     while (!heap.empty()) {
         min = heap.extractMin();
-        edges = g.getEdges(min);
-        for (pair<u64, double> edge : edges) {
-            nextNode   = edge.first;
-            edgeLength = edge.second;
+        minIdx = g.getIndex(min);
+        for (u32 e = g.edgesBegin(minIdx); e != g.edgesEnd(minIdx); ++e) {
+            nextNode   = g.getId(g.getTarget(e));
+            edgeLength = g.getWeight(e);
             distance   = currentCostMap[min] + edgeLength;
 
             // Check if the destination node has been reached
@@ -193,14 +531,14 @@ std::pair<std::list<u64>, double> simpleMemoryBoundedAStarSearch(Graph<OsmNode>
 
             // Update distance and predecessor and add node to the heap (only if the node is new)
             if (!currentCostMap.count(nextNode)) {
-                currentCoords = g.getNode(nextNode).coordinates;
+                currentCoords = g.getNode(g.getIndex(nextNode)).coordinates;
                 estimate = currentCoords.haversine(endCoords);
                 totalDistance = distance + estimate;
 
                 if (heap.getSize() == maxSize) {
                     max = heap.extractMax();
 
-                    currentCoords = g.getNode(max).coordinates;
+                    currentCoords = g.getNode(g.getIndex(max)).coordinates;
                     estimate = currentCoords.haversine(endCoords);
                     maxF = currentCostMap[max] + estimate;
 
@@ -239,10 +577,11 @@ bool contains(std::list<u64> l, u64 value) {
     return false;
 }
 
-pair<bool, pair<list<u64>, double>> search(Graph<OsmNode> graph, list<u64> path, u64 end, double g, double bound) {
+pair<bool, pair<list<u64>, double>> search(const Graph<OsmNode>& graph, list<u64> path, u64 end, double g, double bound) {
     u64 current = path.back();
-    Coordinates endCoords     = graph.getNode(end).coordinates;
-    Coordinates currentCoords = graph.getNode(current).coordinates;
+    u32 currentIdx = graph.getIndex(current);
+    Coordinates endCoords     = graph.getNode(graph.getIndex(end)).coordinates;
+    Coordinates currentCoords = graph.getNode(currentIdx).coordinates;
     double h = currentCoords.haversine(endCoords);
     double f = g + h;
 
@@ -258,15 +597,15 @@ pair<bool, pair<list<u64>, double>> search(Graph<OsmNode> graph, list<u64> path,
     double t, min = NOT_FOUND;
     list<u64> minPath = path;
 
-    for (pair<u64, double> edge : graph.getEdges(current)) {
-        node = edge.first;
+    for (u32 e = graph.edgesBegin(currentIdx); e != graph.edgesEnd(currentIdx); ++e) {
+        node = graph.getId(graph.getTarget(e));
         if (contains(path, node)) {
             continue;
         }
         
         path.push_back(node);
         
-        found = search(graph, path, end, g + edge.second, bound);
+        found = search(graph, path, end, g + graph.getWeight(e), bound);
         t = found.second.second;
 
         if (found.first && t != NOT_FOUND) {
@@ -282,9 +621,9 @@ pair<bool, pair<list<u64>, double>> search(Graph<OsmNode> graph, list<u64> path,
     return make_pair(false, make_pair(minPath, min));
 }
 
-pair<list<u64>, double> iterativeDeepeningAStarSearch(Graph<OsmNode> g, u64 start, u64 end) {
-    Coordinates endCoords     = g.getNode(end).coordinates;
-    Coordinates currentCoords = g.getNode(start).coordinates;
+pair<list<u64>, double> iterativeDeepeningAStarSearch(const Graph<OsmNode>& g, u64 start, u64 end) {
+    Coordinates endCoords     = g.getNode(g.getIndex(end)).coordinates;
+    Coordinates currentCoords = g.getNode(g.getIndex(start)).coordinates;
 
     double t, bound = currentCoords.haversine(endCoords);
     pair<bool, pair<list<u64>, double>> found = make_pair<bool, pair<list<u64>, double>>(false, make_pair<list<u64>, double>({}, 0));
@@ -2,6 +2,8 @@
 #ifndef A_STAR_H
 #define A_STAR_H
 
+#include <algorithm>
+#include <cfloat>
 #include <utility>
 #include <list>
 #include <vector>
@@ -9,19 +11,177 @@
 #include "../graph.hpp"
 #include "../types.hpp"
 #include "../cvrp/stage_1.hpp"
+#include "../data_structures/binary_heap.hpp"
+#include "../data_structures/dary_heap.hpp"
+#include "../data_structures/dial_queue.hpp"
+#include "../data_structures/fibonacci_heap.hpp"
+#include "../data_structures/radix_heap.hpp"
+#include "landmarks.hpp"
 
 struct ShortestPathResult {
     std::list<u64> path;
     double distance;
 };
 
+// State of dijkstra, kept between searches so that each thread allocates it
+// once. The entries of a node only belong to the current search if its
+// generation is the current one, so starting a search does not touch them.
+struct SearchWorkspace {
+    static const u32 NO_PREDECESSOR = Graph<OsmNode>::INVALID_INDEX;
+
+    u32 generation = 0;
+    std::vector<u32> reachedIn, endIn;
+    std::vector<double> distances;
+    std::vector<u32> predecessors;
+
+    BinaryHeap<u32> binHeap;
+    FibonacciHeap<u32> fibHeap;
+    RadixHeap<u32> radixHeap;
+    DialQueue<u32> dialQueue;
+    DaryHeap<u32, 4> quaternaryHeap;
+    DaryHeap<u32, 8> octonaryHeap;
+
+    // Handles of the nodes in the heap in use (ids for all but the Fibonacci heap)
+    std::vector<u64> heapIds;
+    std::vector<FHNode<u32>*> fibHeapNodes;
+
+    // Prepares the workspace for a search on a graph of numNodes nodes
+    void start(u32 numNodes) {
+        if (reachedIn.size() != numNodes) {
+            reachedIn.assign(numNodes, 0);
+            endIn.assign(numNodes, 0);
+            distances.resize(numNodes);
+            predecessors.resize(numNodes);
+            heapIds.resize(numNodes);
+            fibHeapNodes.resize(numNodes);
+            generation = 0;
+        }
+
+        // Generation 0 marks nodes that were never reached, so the arrays are
+        // only cleared when the counter wraps around
+        if (++generation == 0) {
+            std::fill(reachedIn.begin(), reachedIn.end(), 0);
+            std::fill(endIn.begin(), endIn.end(), 0);
+            generation = 1;
+        }
+
+        binHeap.clear();
+        fibHeap.clear();
+        radixHeap.clear();
+        dialQueue.clear();
+        quaternaryHeap.clear();
+        octonaryHeap.clear();
+    }
+
+    bool reached(u32 node) const {
+        return reachedIn[node] == generation;
+    }
+};
+
+// State of batchedDijkstraDistances, kept between searches like SearchWorkspace.
+// Every node has one distance per lane, stored together so that relaxing an
+// edge updates all lanes with a loop the compiler can vectorize.
+struct BatchWorkspace {
+    static constexpr u32 LANES = 4;
+
+    u32 generation = 0;
+    std::vector<u32> reachedIn, endIn;
+    std::vector<double> lanes;
+
+    // Key of the queue entry of each node not scanned since its distances
+    // last improved (DBL_MAX if none), older entries being stale
+    std::vector<double> queuedKeys;
+    DaryHeap<u32, 4> heap;
+
+    void start(u32 numNodes) {
+        if (reachedIn.size() != numNodes) {
+            reachedIn.assign(numNodes, 0);
+            endIn.assign(numNodes, 0);
+            lanes.resize((size_t) numNodes * LANES);
+            queuedKeys.resize(numNodes);
+            generation = 0;
+        }
+
+        if (++generation == 0) {
+            std::fill(reachedIn.begin(), reachedIn.end(), 0);
+            std::fill(endIn.begin(), endIn.end(), 0);
+            generation = 1;
+        }
+        heap.clear();
+    }
+
+    // Distances of node, which are set to DBL_MAX the first time it is reached
+    double* reach(u32 node) {
+        double* d = lanes.data() + (size_t) node * LANES;
+        if (reachedIn[node] != generation) {
+            reachedIn[node] = generation;
+            std::fill(d, d + LANES, DBL_MAX);
+            queuedKeys[node] = DBL_MAX;
+        }
+        return d;
+    }
+
+    bool reached(u32 node) const {
+        return reachedIn[node] == generation;
+    }
+};
+
 std::vector<ShortestPathResult> dijkstra(const Graph<OsmNode>& g, u64 start,
     const std::vector<u64>& endVec, ShortestPathDataStructure dataStructure);
 
-std::pair<std::list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end);
+// Same as above, reusing the given workspace instead of allocating one
+std::vector<ShortestPathResult> dijkstra(const Graph<OsmNode>& g, u64 start,
+    const std::vector<u64>& endVec, ShortestPathDataStructure dataStructure,
+    SearchWorkspace& workspace);
+
+// Same search as dijkstra, only writing the distance to every end (DBL_MAX if
+// unreachable). The shortest path tree stays in the workspace until its next
+// search, so paths can still be built with searchPath when needed.
+void dijkstraDistances(const Graph<OsmNode>& g, u64 start, const std::vector<u64>& endVec,
+    ShortestPathDataStructure dataStructure, SearchWorkspace& workspace,
+    std::vector<double>& distances);
+
+// Distances from up to BatchWorkspace::LANES sources to every end at once:
+// distances[i][j] for sources[i] and endVec[j], DBL_MAX if unreachable. A
+// node is queued with the smallest of its distances that improved and, when
+// scanned, relaxes its edges for all sources, so sources close to each other
+// share most of the work.
+void batchedDijkstraDistances(const Graph<OsmNode>& g, const u64* sources, u32 numSources,
+    const std::vector<u64>& endVec, BatchWorkspace& workspace,
+    std::vector<std::vector<double>>& distances);
+
+// Path from the start of the last search in workspace to end (empty if end
+// was not reached)
+std::list<u64> searchPath(const Graph<OsmNode>& g, const SearchWorkspace& workspace, u64 end);
+
+// The straight-line distance to the target is multiplied by heuristicScale,
+// which must not exceed the cost of travelling one metre (see costPerMeterBound).
+// If settledNodes is not null, it receives the number of nodes settled.
+std::pair<std::list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end,
+    double heuristicScale = 1, u32* settledNodes = nullptr);
+
+// A* guided by the landmark bounds (ALT), which must have been selected in g
+std::pair<std::list<u64>, double> aStarSearch(const Graph<OsmNode>& g, u64 start, u64 end,
+    const Landmarks& landmarks, u32* settledNodes = nullptr);
+
+// Searches forward from start and backward (over the reverse view of g) from
+// end at once, stopping when no path through an unsettled node can be shorter
+// than the best one found. settledNodes counts the nodes of both searches.
+std::pair<std::list<u64>, double> bidirectionalDijkstra(const Graph<OsmNode>& g,
+    const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, u32* settledNodes = nullptr);
+
+// Bidirectional A*, using half the difference between the estimates to end and
+// from start as potential, so that both searches see the same reduced costs
+std::pair<std::list<u64>, double> bidirectionalAStarSearch(const Graph<OsmNode>& g,
+    const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, double heuristicScale = 1,
+    u32* settledNodes = nullptr);
+
+std::pair<std::list<u64>, double> bidirectionalAStarSearch(const Graph<OsmNode>& g,
+    const ReverseGraph<OsmNode>& reverse, u64 start, u64 end, const Landmarks& landmarks,
+    u32* settledNodes = nullptr);
 
-std::pair<std::list<u64>, double> simpleMemoryBoundedAStarSearch(Graph<OsmNode> g, u64 start, u64 end, int maxSize);
+std::pair<std::list<u64>, double> simpleMemoryBoundedAStarSearch(const Graph<OsmNode>& g, u64 start, u64 end, int maxSize);
 
-std::pair<std::list<u64>, double> iterativeDeepeningAStarSearch(Graph<OsmNode> g, u64 start, u64 end);
+std::pair<std::list<u64>, double> iterativeDeepeningAStarSearch(const Graph<OsmNode>& g, u64 start, u64 end);
 
 #endif // A_STAR_H
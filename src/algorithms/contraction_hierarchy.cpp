@@ -0,0 +1,627 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include "contraction_hierarchy.hpp"
+#include "../utils.hpp"
+
+using namespace std;
+using chrono::high_resolution_clock;
+using chrono::milliseconds;
+
+static const char CH_MAGIC[8] = {'C', 'V', 'R', 'P', 'C', 'H', 'I', 'E'};
+static const u32 CH_VERSION = 1;
+
+// Witness searches give up after settling this many nodes, which may add
+// unnecessary shortcuts but never misses a necessary one. Priorities are only
+// estimates, so they use shorter searches.
+static const u32 WITNESS_SETTLE_LIMIT = 500;
+static const u32 PRIORITY_SETTLE_LIMIT = 50;
+
+using HeapEntry = pair<double, u32>;
+using MinHeap = priority_queue<HeapEntry, vector<HeapEntry>, greater<HeapEntry>>;
+
+struct HierarchyFileHeader {
+    char magic[8];
+    u32 version;
+    u32 reserved;
+    u64 fingerprint;
+    u64 numNodes, numForwardArcs, numBackwardArcs, numShortcuts;
+};
+
+// Remaining graph while nodes are being contracted. Arcs to contracted nodes
+// are removed, so every arc in out and in connects two remaining nodes.
+class Contraction {
+    public:
+        using Arc = ContractionHierarchy::Arc;
+
+        struct Shortcut {
+            u32 from, to;
+            double weight;
+        };
+
+        explicit Contraction(const Graph<OsmNode>& graph) : out(graph.numNodes()),
+                in(graph.numNodes()), contracted(graph.numNodes(), false),
+                depth(graph.numNodes(), 0), contractedNeighbors(graph.numNodes(), 0),
+                distances(graph.numNodes(), DBL_MAX), isTarget(graph.numNodes(), false) {
+            for (u32 u = 0; u < graph.numNodes(); ++u) {
+                for (u32 e = graph.edgesBegin(u); e != graph.edgesEnd(u); ++e) {
+                    u32 v = graph.getTarget(e);
+                    if (u != v) addArc(u, v, graph.getWeight(e), ContractionHierarchy::NO_NODE);
+                }
+            }
+        }
+
+        // Favours nodes whose contraction removes more edges than it adds,
+        // spreading contraction evenly over the graph
+        int priority(u32 v) {
+            shortcuts.clear();
+            findShortcuts(v, PRIORITY_SETTLE_LIMIT, shortcuts);
+            int edgeDifference = (int) shortcuts.size() - (int) (in[v].size() + out[v].size());
+            return 2 * edgeDifference + contractedNeighbors[v] + depth[v];
+        }
+
+        // Removes v from the graph, returning its arcs to the remaining nodes
+        void contract(u32 v, vector<Arc>& forward, vector<Arc>& backward,
+                vector<u32>& neighbors) {
+            shortcuts.clear();
+            findShortcuts(v, WITNESS_SETTLE_LIMIT, shortcuts);
+
+            forward = out[v];
+            backward = in[v];
+
+            neighbors.clear();
+            for (const Arc& arc : out[v]) {
+                eraseArc(in[arc.node], v);
+                neighbors.push_back(arc.node);
+            }
+            for (const Arc& arc : in[v]) {
+                eraseArc(out[arc.node], v);
+                neighbors.push_back(arc.node);
+            }
+            sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+            for (const Shortcut& shortcut : shortcuts) {
+                addArc(shortcut.from, shortcut.to, shortcut.weight, v);
+            }
+
+            contracted[v] = true;
+            out[v] = vector<Arc>();
+            in[v] = vector<Arc>();
+
+            for (u32 neighbor : neighbors) {
+                ++contractedNeighbors[neighbor];
+                depth[neighbor] = max(depth[neighbor], depth[v] + 1);
+            }
+        }
+    private:
+        vector<vector<Arc>> out, in;
+        vector<bool> contracted;
+        vector<int> depth, contractedNeighbors;
+        vector<Shortcut> shortcuts;
+
+        vector<double> distances;
+        vector<bool> isTarget;
+        vector<u32> touched;
+        MinHeap heap;
+
+        // Keeps only the shortest of parallel arcs
+        void addArc(u32 from, u32 to, double weight, u32 middle) {
+            for (Arc& arc : out[from]) {
+                if (arc.node != to) continue;
+
+                if (weight < arc.weight) {
+                    arc.weight = weight;
+                    arc.middle = middle;
+                    for (Arc& reverse : in[to]) {
+                        if (reverse.node == from) {
+                            reverse.weight = weight;
+                            reverse.middle = middle;
+                        }
+                    }
+                }
+                return;
+            }
+
+            out[from].push_back({to, middle, weight});
+            in[to].push_back({from, middle, weight});
+        }
+
+        static void eraseArc(vector<Arc>& arcs, u32 node) {
+            arcs.erase(remove_if(arcs.begin(), arcs.end(), [node](const Arc& arc) {
+                return arc.node == node;
+            }), arcs.end());
+        }
+
+        // Dijkstra from source in the remaining graph without avoid, up to
+        // maxDistance or until every target has been settled
+        void witnessSearch(u32 source, u32 avoid, double maxDistance, u32 settleLimit,
+                u32 numTargets) {
+            for (u32 node : touched) {
+                distances[node] = DBL_MAX;
+            }
+            touched.clear();
+            heap = MinHeap();
+
+            distances[source] = 0;
+            touched.push_back(source);
+            heap.push({0, source});
+
+            u32 settled = 0;
+            while (!heap.empty()) {
+                auto [distance, node] = heap.top();
+                heap.pop();
+
+                if (distance > distances[node]) continue;
+                if (distance > maxDistance || ++settled > settleLimit) break;
+                if (isTarget[node] && --numTargets == 0) break;
+
+                for (const Arc& arc : out[node]) {
+                    if (arc.node == avoid) continue;
+
+                    double newDistance = distance + arc.weight;
+                    if (newDistance < distances[arc.node]) {
+                        if (distances[arc.node] == DBL_MAX) touched.push_back(arc.node);
+                        distances[arc.node] = newDistance;
+                        heap.push({newDistance, arc.node});
+                    }
+                }
+            }
+        }
+
+        // A shortcut u -> x is needed unless a path from u to x that avoids v
+        // is at most as long as u -> v -> x
+        void findShortcuts(u32 v, u32 settleLimit, vector<Shortcut>& result) {
+            for (const Arc& outgoing : out[v]) {
+                isTarget[outgoing.node] = true;
+            }
+
+            for (const Arc& incoming : in[v]) {
+                u32 u = incoming.node;
+
+                double maxOutgoing = -1;
+                u32 numTargets = 0;
+                for (const Arc& outgoing : out[v]) {
+                    if (outgoing.node != u) {
+                        maxOutgoing = max(maxOutgoing, outgoing.weight);
+                        ++numTargets;
+                    }
+                }
+                if (numTargets == 0) continue;
+
+                // u itself is settled first and is not a target of this search
+                if (isTarget[u]) ++numTargets;
+                witnessSearch(u, v, incoming.weight + maxOutgoing, settleLimit, numTargets);
+
+                for (const Arc& outgoing : out[v]) {
+                    double weight = incoming.weight + outgoing.weight;
+                    if (outgoing.node != u && distances[outgoing.node] > weight) {
+                        result.push_back({u, outgoing.node, weight});
+                    }
+                }
+            }
+
+            for (const Arc& outgoing : out[v]) {
+                isTarget[outgoing.node] = false;
+            }
+        }
+};
+
+// Flattens per-node arc lists into CSR form
+static void flattenArcs(vector<vector<ContractionHierarchy::Arc>>& lists,
+        vector<u32>& offsets, vector<ContractionHierarchy::Arc>& arcs) {
+    offsets.assign(1, 0);
+    arcs.clear();
+
+    for (auto& list : lists) {
+        arcs.insert(arcs.end(), list.begin(), list.end());
+        offsets.push_back(arcs.size());
+        list = vector<ContractionHierarchy::Arc>();
+    }
+}
+
+void ContractionHierarchy::build(const Graph<OsmNode>& graph, bool printLogs) {
+    auto start = high_resolution_clock::now();
+
+    u32 n = graph.numNodes();
+    Contraction contraction(graph);
+
+    vector<int> priorities(n);
+    priority_queue<pair<int, u32>, vector<pair<int, u32>>, greater<pair<int, u32>>> queue;
+    for (u32 v = 0; v < n; ++v) {
+        priorities[v] = contraction.priority(v);
+        queue.push({priorities[v], v});
+    }
+
+    ranks.assign(n, NO_NODE);
+    vector<vector<Arc>> forward(n), backward(n);
+    vector<u32> neighbors;
+    u32 rank = 0;
+
+    while (!queue.empty()) {
+        auto [priority, v] = queue.top();
+        queue.pop();
+        if (ranks[v] != NO_NODE || priority != priorities[v]) continue;
+
+        // Priorities of nodes that are not neighbours of the last contracted
+        // nodes may be outdated, so they are checked before contracting
+        priorities[v] = contraction.priority(v);
+        if (!queue.empty() && priorities[v] > queue.top().first) {
+            queue.push({priorities[v], v});
+            continue;
+        }
+
+        contraction.contract(v, forward[v], backward[v], neighbors);
+        ranks[v] = rank++;
+
+        for (u32 neighbor : neighbors) {
+            priorities[neighbor] = contraction.priority(neighbor);
+            queue.push({priorities[neighbor], neighbor});
+        }
+    }
+
+    shortcuts = 0;
+    for (u32 v = 0; v < n; ++v) {
+        for (const Arc& arc : forward[v]) shortcuts += arc.middle != NO_NODE;
+        for (const Arc& arc : backward[v]) shortcuts += arc.middle != NO_NODE;
+    }
+
+    flattenArcs(forward, forwardOffsets, forwardArcs);
+    flattenArcs(backward, backwardOffsets, backwardArcs);
+    fingerprint = graph.fingerprint();
+
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Built contraction hierarchy of " << n << " nodes with " << shortcuts
+            << " shortcuts in " << interval<milliseconds>(start, end) << "ms\n";
+    }
+}
+
+bool ContractionHierarchy::read(const char* path, const Graph<OsmNode>& graph) {
+    ifstream ifs(path, ios::binary);
+    if (!ifs.good()) return false;
+
+    HierarchyFileHeader header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    if (memcmp(header.magic, CH_MAGIC, sizeof(CH_MAGIC)) != 0 || header.version != CH_VERSION ||
+            header.numNodes != graph.numNodes() || header.fingerprint != graph.fingerprint()) {
+        return false;
+    }
+
+    u64 n = header.numNodes;
+    ranks.resize(n);
+    forwardOffsets.resize(n + 1);
+    backwardOffsets.resize(n + 1);
+    forwardArcs.resize(header.numForwardArcs);
+    backwardArcs.resize(header.numBackwardArcs);
+
+    ifs.read(reinterpret_cast<char*>(ranks.data()), n * sizeof(u32));
+    ifs.read(reinterpret_cast<char*>(forwardOffsets.data()), (n + 1) * sizeof(u32));
+    ifs.read(reinterpret_cast<char*>(forwardArcs.data()), forwardArcs.size() * sizeof(Arc));
+    ifs.read(reinterpret_cast<char*>(backwardOffsets.data()), (n + 1) * sizeof(u32));
+    ifs.read(reinterpret_cast<char*>(backwardArcs.data()), backwardArcs.size() * sizeof(Arc));
+
+    if (!ifs) {
+        *this = ContractionHierarchy();
+        return false;
+    }
+
+    fingerprint = header.fingerprint;
+    shortcuts = header.numShortcuts;
+    return true;
+}
+
+void ContractionHierarchy::write(const char* path) const {
+    HierarchyFileHeader header = {};
+    memcpy(header.magic, CH_MAGIC, sizeof(CH_MAGIC));
+    header.version = CH_VERSION;
+    header.fingerprint = fingerprint;
+    header.numNodes = ranks.size();
+    header.numForwardArcs = forwardArcs.size();
+    header.numBackwardArcs = backwardArcs.size();
+    header.numShortcuts = shortcuts;
+
+    ofstream ofs(path, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(ranks.data()), ranks.size() * sizeof(u32));
+    ofs.write(reinterpret_cast<const char*>(forwardOffsets.data()), forwardOffsets.size() * sizeof(u32));
+    ofs.write(reinterpret_cast<const char*>(forwardArcs.data()), forwardArcs.size() * sizeof(Arc));
+    ofs.write(reinterpret_cast<const char*>(backwardOffsets.data()), backwardOffsets.size() * sizeof(u32));
+    ofs.write(reinterpret_cast<const char*>(backwardArcs.data()), backwardArcs.size() * sizeof(Arc));
+    ofs.close();
+}
+
+const ContractionHierarchy::Arc* ContractionHierarchy::findArc(const Arc* begin,
+        const Arc* end, u32 node) const {
+    for (const Arc* arc = begin; arc != end; ++arc) {
+        if (arc->node == node) return arc;
+    }
+    return nullptr;
+}
+
+void ContractionHierarchy::unpackEdge(u32 from, u32 to, u32 middle, vector<u32>& path) const {
+    struct Edge {
+        u32 from, to, middle;
+    };
+    vector<Edge> stack = {{from, to, middle}};
+
+    // The edge from -> middle is a backward arc of middle and middle -> to is a
+    // forward arc of middle, since middle was contracted before both
+    while (!stack.empty()) {
+        Edge edge = stack.back();
+        stack.pop_back();
+
+        if (edge.middle == NO_NODE) {
+            path.push_back(edge.to);
+            continue;
+        }
+
+        u32 m = edge.middle;
+        const Arc* first = findArc(backwardBegin(m), backwardEnd(m), edge.from);
+        const Arc* second = findArc(forwardBegin(m), forwardEnd(m), edge.to);
+
+        stack.push_back({m, edge.to, second->middle});
+        stack.push_back({edge.from, m, first->middle});
+    }
+}
+
+ContractionHierarchyQuery::ContractionHierarchyQuery(const ContractionHierarchy& ch) : ch(ch),
+    forwardDistances(ch.numNodes(), DBL_MAX), backwardDistances(ch.numNodes(), DBL_MAX),
+    forwardParents(ch.numNodes()), backwardParents(ch.numNodes()),
+    forwardMiddles(ch.numNodes()), backwardMiddles(ch.numNodes()) {}
+
+void ContractionHierarchyQuery::reset() {
+    for (u32 node : touched) {
+        forwardDistances[node] = DBL_MAX;
+        backwardDistances[node] = DBL_MAX;
+    }
+    touched.clear();
+}
+
+double ContractionHierarchyQuery::distance(u32 source, u32 target) {
+    static const u32 NO_NODE = ContractionHierarchy::NO_NODE;
+
+    reset();
+    this->source = source;
+    this->target = target;
+    meeting = NO_NODE;
+
+    forwardDistances[source] = 0;
+    forwardParents[source] = NO_NODE;
+    backwardDistances[target] = 0;
+    backwardParents[target] = NO_NODE;
+    touched.push_back(source);
+    touched.push_back(target);
+
+    MinHeap forwardHeap, backwardHeap;
+    forwardHeap.push({0, source});
+    backwardHeap.push({0, target});
+
+    double best = DBL_MAX;
+    while (!forwardHeap.empty() || !backwardHeap.empty()) {
+        bool forward = backwardHeap.empty() ||
+            (!forwardHeap.empty() && forwardHeap.top().first <= backwardHeap.top().first);
+        MinHeap& heap = forward ? forwardHeap : backwardHeap;
+
+        // Neither search can improve on the best path found so far
+        if (heap.top().first >= best) break;
+
+        auto [distance, node] = heap.top();
+        heap.pop();
+
+        vector<double>& distances = forward ? forwardDistances : backwardDistances;
+        const vector<double>& otherDistances = forward ? backwardDistances : forwardDistances;
+        if (distance > distances[node]) continue;
+
+        if (otherDistances[node] != DBL_MAX && distance + otherDistances[node] < best) {
+            best = distance + otherDistances[node];
+            meeting = node;
+        }
+
+        vector<u32>& parents = forward ? forwardParents : backwardParents;
+        vector<u32>& middles = forward ? forwardMiddles : backwardMiddles;
+        const ContractionHierarchy::Arc* begin = forward ? ch.forwardBegin(node) : ch.backwardBegin(node);
+        const ContractionHierarchy::Arc* end = forward ? ch.forwardEnd(node) : ch.backwardEnd(node);
+
+        for (const ContractionHierarchy::Arc* arc = begin; arc != end; ++arc) {
+            double newDistance = distance + arc->weight;
+            if (newDistance < distances[arc->node]) {
+                if (distances[arc->node] == DBL_MAX && otherDistances[arc->node] == DBL_MAX) {
+                    touched.push_back(arc->node);
+                }
+                distances[arc->node] = newDistance;
+                parents[arc->node] = node;
+                middles[arc->node] = arc->middle;
+                heap.push({newDistance, arc->node});
+            }
+        }
+    }
+
+    return best;
+}
+
+list<u64> ContractionHierarchyQuery::path(const Graph<OsmNode>& graph) const {
+    static const u32 NO_NODE = ContractionHierarchy::NO_NODE;
+
+    list<u64> result;
+    if (meeting == NO_NODE) return result;
+
+    // Edges of the forward search tree from the source to the meeting node
+    vector<u32> upward;
+    for (u32 node = meeting; node != source; node = forwardParents[node]) {
+        upward.push_back(node);
+    }
+    reverse(upward.begin(), upward.end());
+
+    vector<u32> nodes = {source};
+    u32 previous = source;
+    for (u32 node : upward) {
+        ch.unpackEdge(previous, node, forwardMiddles[node], nodes);
+        previous = node;
+    }
+
+    // Edges of the backward search tree from the meeting node to the target
+    for (u32 node = meeting; node != target; node = backwardParents[node]) {
+        ch.unpackEdge(node, backwardParents[node], backwardMiddles[node], nodes);
+    }
+
+    for (u32 node : nodes) {
+        result.push_back(graph.getId(node));
+    }
+    return result;
+}
+
+void ContractionHierarchyQuery::upwardSearch(u32 node, bool forward,
+        const function<void(u32, double)>& settled) {
+    reset();
+    source = target = meeting = ContractionHierarchy::NO_NODE;
+
+    vector<double>& distances = forward ? forwardDistances : backwardDistances;
+    distances[node] = 0;
+    touched.push_back(node);
+
+    MinHeap heap;
+    heap.push({0, node});
+
+    while (!heap.empty()) {
+        auto [distance, v] = heap.top();
+        heap.pop();
+        if (distance > distances[v]) continue;
+
+        settled(v, distance);
+
+        const ContractionHierarchy::Arc* begin = forward ? ch.forwardBegin(v) : ch.backwardBegin(v);
+        const ContractionHierarchy::Arc* end = forward ? ch.forwardEnd(v) : ch.backwardEnd(v);
+
+        for (const ContractionHierarchy::Arc* arc = begin; arc != end; ++arc) {
+            double newDistance = distance + arc->weight;
+            if (newDistance < distances[arc->node]) {
+                if (distances[arc->node] == DBL_MAX) touched.push_back(arc->node);
+                distances[arc->node] = newDistance;
+                heap.push({newDistance, arc->node});
+            }
+        }
+    }
+}
+
+ContractionHierarchyBuckets::ContractionHierarchyBuckets(const ContractionHierarchy& ch,
+        const vector<u32>& targets, u32 numThreads) : numTargets(targets.size()),
+        offsets(ch.numNodes() + 1, 0) {
+    struct NodeEntry {
+        u32 node;
+        Entry entry;
+    };
+
+    // Backward searches run in parallel, each thread keeping its own entries
+    numThreads = max(numThreads, 1u);
+    vector<vector<NodeEntry>> threadEntries(numThreads);
+    vector<ContractionHierarchyQuery> queries;
+    queries.reserve(numThreads);
+    for (u32 t = 0; t < numThreads; ++t) {
+        queries.emplace_back(ch);
+    }
+
+    runWorkStealing(targets.size(), numThreads, 1, [&](size_t i, u32 thread) {
+        queries[thread].upwardSearch(targets[i], false, [&](u32 node, double distance) {
+            threadEntries[thread].push_back({node, {(u32) i, distance}});
+        });
+    });
+
+    // Counting sort of the entries by node
+    for (const auto& nodeEntries : threadEntries) {
+        for (const NodeEntry& e : nodeEntries) {
+            ++offsets[e.node + 1];
+        }
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    entries.resize(offsets.back());
+    vector<u32> positions(offsets.begin(), offsets.end() - 1);
+    for (auto& nodeEntries : threadEntries) {
+        for (const NodeEntry& e : nodeEntries) {
+            entries[positions[e.node]++] = e.entry;
+        }
+        nodeEntries = vector<NodeEntry>();
+    }
+}
+
+void ContractionHierarchyBuckets::distances(ContractionHierarchyQuery& query, u32 source,
+        vector<double>& result) const {
+    result.assign(numTargets, DBL_MAX);
+
+    query.upwardSearch(source, true, [&](u32 node, double distance) {
+        for (u32 i = offsets[node]; i < offsets[node + 1]; ++i) {
+            const Entry& e = entries[i];
+            if (distance + e.distance < result[e.target]) {
+                result[e.target] = distance + e.distance;
+            }
+        }
+    });
+}
+
+PhastSweep::PhastSweep(const ContractionHierarchy& ch) : positions(ch.numNodes()),
+        offsets(ch.numNodes() + 1, 0) {
+    u32 n = ch.numNodes();
+    for (u32 v = 0; v < n; ++v) {
+        positions[v] = n - 1 - ch.getRank(v);
+    }
+
+    // Backward arcs of v come from nodes of higher rank, which are swept first
+    for (u32 v = 0; v < n; ++v) {
+        offsets[positions[v] + 1] = ch.backwardEnd(v) - ch.backwardBegin(v);
+    }
+    for (u32 i = 1; i <= n; ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    arcs.resize(offsets.back());
+    for (u32 v = 0; v < n; ++v) {
+        DownArc* out = arcs.data() + offsets[positions[v]];
+        for (const auto* arc = ch.backwardBegin(v); arc != ch.backwardEnd(v); ++arc) {
+            *out++ = {positions[arc->node], arc->weight};
+        }
+    }
+}
+
+void PhastSweep::distances(ContractionHierarchyQuery& query, const u32* sources,
+        u32 numSources, const vector<u32>& targets, vector<vector<double>>& result,
+        vector<double>& lanes) const {
+    u32 n = positions.size();
+    lanes.assign((size_t) n * LANES, DBL_MAX);
+
+    for (u32 lane = 0; lane < numSources; ++lane) {
+        query.upwardSearch(sources[lane], true, [&](u32 node, double distance) {
+            lanes[(size_t) positions[node] * LANES + lane] = distance;
+        });
+    }
+
+    // Unused lanes stay at DBL_MAX, which keeps the inner loop branch free
+    for (u32 p = 0; p < n; ++p) {
+        double* d = lanes.data() + (size_t) p * LANES;
+        for (u32 i = offsets[p]; i < offsets[p + 1]; ++i) {
+            const double* from = lanes.data() + (size_t) arcs[i].from * LANES;
+            double weight = arcs[i].weight;
+            for (u32 lane = 0; lane < LANES; ++lane) {
+                d[lane] = min(d[lane], from[lane] + weight);
+            }
+        }
+    }
+
+    result.resize(numSources);
+    for (u32 lane = 0; lane < numSources; ++lane) {
+        result[lane].resize(targets.size());
+        for (size_t j = 0; j < targets.size(); ++j) {
+            double d = lanes[(size_t) positions[targets[j]] * LANES + lane];
+            result[lane][j] = d < DBL_MAX ? d : DBL_MAX;
+        }
+    }
+}
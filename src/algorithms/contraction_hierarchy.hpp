@@ -0,0 +1,169 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <functional>
+#include <list>
+#include <vector>
+#include "../graph.hpp"
+#include "../osm/osm.hpp"
+#include "../types.hpp"
+
+// Contraction hierarchy of a road graph. Nodes are contracted one at a time
+// (in order of edge difference, contracted neighbours and depth), adding
+// shortcuts between their neighbours when no witness path exists. A query
+// then only relaxes edges towards nodes contracted later: forward from the
+// source and backward from the target.
+//
+// Node indices are those of the graph the hierarchy was built from, using the
+// weights of its active metric.
+class ContractionHierarchy {
+    public:
+        static constexpr u32 NO_NODE = UINT32_MAX;
+
+        // Edge towards a node of higher rank. In the backward graph, the edge
+        // goes from node to the owner of the list in the road graph. Shortcuts
+        // replace the path through middle.
+        struct Arc {
+            u32 node;
+            u32 middle;
+            double weight;
+        };
+
+        ContractionHierarchy() {}
+
+        void build(const Graph<OsmNode>& graph, bool printLogs = false);
+
+        // Loads a hierarchy written by write. Returns false if the file does
+        // not exist or was built from a different graph.
+        bool read(const char* path, const Graph<OsmNode>& graph);
+
+        void write(const char* path) const;
+
+        u32 numNodes() const {
+            return ranks.size();
+        }
+
+        size_t numShortcuts() const {
+            return shortcuts;
+        }
+
+        u32 getRank(u32 node) const {
+            return ranks[node];
+        }
+
+        const Arc* forwardBegin(u32 node) const {
+            return forwardArcs.data() + forwardOffsets[node];
+        }
+
+        const Arc* forwardEnd(u32 node) const {
+            return forwardArcs.data() + forwardOffsets[node + 1];
+        }
+
+        const Arc* backwardBegin(u32 node) const {
+            return backwardArcs.data() + backwardOffsets[node];
+        }
+
+        const Arc* backwardEnd(u32 node) const {
+            return backwardArcs.data() + backwardOffsets[node + 1];
+        }
+
+        // Appends the road graph nodes of the edge from -> to (without from)
+        void unpackEdge(u32 from, u32 to, u32 middle, std::vector<u32>& path) const;
+    private:
+        u64 fingerprint = 0;
+        size_t shortcuts = 0;
+
+        std::vector<u32> ranks;
+        std::vector<u32> forwardOffsets, backwardOffsets;
+        std::vector<Arc> forwardArcs, backwardArcs;
+
+        const Arc* findArc(const Arc* begin, const Arc* end, u32 node) const;
+};
+
+// Point-to-point queries on a hierarchy. Keeps per-node search state between
+// queries, so each thread should use its own instance.
+class ContractionHierarchyQuery {
+    public:
+        explicit ContractionHierarchyQuery(const ContractionHierarchy& ch);
+
+        // Returns DBL_MAX if there is no path
+        double distance(u32 source, u32 target);
+
+        // Path of OSM node ids of the last query, empty if there was no path
+        std::list<u64> path(const Graph<OsmNode>& graph) const;
+
+        // Searches from node using only forward (or only backward) arcs,
+        // calling settled(node, distance) for every node it settles
+        void upwardSearch(u32 node, bool forward,
+            const std::function<void(u32, double)>& settled);
+    private:
+        const ContractionHierarchy& ch;
+
+        std::vector<double> forwardDistances, backwardDistances;
+        std::vector<u32> forwardParents, backwardParents;
+        std::vector<u32> forwardMiddles, backwardMiddles;
+        std::vector<u32> touched;
+
+        u32 source = ContractionHierarchy::NO_NODE, target = ContractionHierarchy::NO_NODE;
+        u32 meeting = ContractionHierarchy::NO_NODE;
+
+        void reset();
+};
+
+// Many-to-many distances on a hierarchy. A backward search from every target
+// leaves its distance to each node it settles in that node's bucket, so the
+// distances from a source to all targets take a single forward search that
+// scans the buckets of the nodes it settles.
+class ContractionHierarchyBuckets {
+    public:
+        ContractionHierarchyBuckets(const ContractionHierarchy& ch,
+            const std::vector<u32>& targets, u32 numThreads = 1);
+
+        // Distances from source to every target, DBL_MAX if there is no path
+        void distances(ContractionHierarchyQuery& query, u32 source,
+            std::vector<double>& result) const;
+
+        size_t numEntries() const {
+            return entries.size();
+        }
+    private:
+        struct Entry {
+            u32 target;
+            double distance;
+        };
+
+        size_t numTargets;
+        std::vector<u32> offsets;
+        std::vector<Entry> entries;
+};
+
+// One-to-all distances on a hierarchy (PHAST). After an upward search from the
+// source, the nodes are swept in decreasing rank, relaxing the arcs that reach
+// each node from higher ranked nodes. Nodes and arcs are stored in sweep order,
+// so the sweep reads memory sequentially. LANES sources are swept together,
+// with their distances to a node stored next to each other.
+class PhastSweep {
+    public:
+        static constexpr u32 LANES = 4;
+
+        explicit PhastSweep(const ContractionHierarchy& ch);
+
+        // Distances from up to LANES sources to every target: result[i][j]
+        // for sources[i] and targets[j], DBL_MAX if there is no path. lanes
+        // is working memory, reused between calls.
+        void distances(ContractionHierarchyQuery& query, const u32* sources, u32 numSources,
+            const std::vector<u32>& targets, std::vector<std::vector<double>>& result,
+            std::vector<double>& lanes) const;
+    private:
+        struct DownArc {
+            u32 from;
+            double weight;
+        };
+
+        // Position of each node in the sweep, and arcs into each position
+        std::vector<u32> positions;
+        std::vector<u32> offsets;
+        std::vector<DownArc> arcs;
+};
+
+#endif // CONTRACTION_HIERARCHY_H
@@ -0,0 +1,154 @@
+#include <cfloat>
+#include "delta_stepping.hpp"
+#include "../utils.hpp"
+
+using namespace std;
+
+DeltaStepping::DeltaStepping(const Graph<OsmNode>& graph, u32 numThreads, double delta)
+        : graph(graph), numThreads(max(numThreads, 1u)), delta(delta),
+        tentative(new atomic<double>[graph.numNodes()]), queuedIn(graph.numNodes()),
+        improved(this->numThreads), barrier(this->numThreads), next(0) {
+    if (this->delta <= 0) {
+        const vector<double>& weights = graph.getWeights();
+        double total = 0;
+        for (double weight : weights) {
+            total += weight;
+        }
+        this->delta = weights.empty() ? 1 : DEFAULT_DELTA_EDGES * total / weights.size();
+        if (this->delta <= 0) this->delta = 1;
+    }
+
+    for (u32 t = 1; t < this->numThreads; ++t) {
+        workers.emplace_back(&DeltaStepping::workerLoop, this, t);
+    }
+}
+
+DeltaStepping::~DeltaStepping() {
+    stopping = true;
+    barrier.wait();
+    for (thread& t : workers) {
+        t.join();
+    }
+}
+
+void DeltaStepping::workerLoop(u32 thread) {
+    while (true) {
+        barrier.wait();
+        if (stopping) return;
+
+        scanFrontier(thread);
+        barrier.wait();
+    }
+}
+
+void DeltaStepping::scanFrontier(u32 thread) {
+    vector<u32>& out = improved[thread];
+
+    for (size_t i = next.fetch_add(CHUNK_SIZE); i < frontier.size(); i = next.fetch_add(CHUNK_SIZE)) {
+        size_t last = min(i + CHUNK_SIZE, frontier.size());
+        for (size_t j = i; j < last; ++j) {
+            u32 node = frontier[j];
+            double distance = tentative[node].load(memory_order_relaxed);
+
+            for (u32 e = graph.edgesBegin(node); e != graph.edgesEnd(node); ++e) {
+                u32 target = graph.getTarget(e);
+                double newDistance = distance + graph.getWeight(e);
+
+                // Atomic minimum, as other threads may relax the same node
+                double old = tentative[target].load(memory_order_relaxed);
+                while (newDistance < old) {
+                    if (tentative[target].compare_exchange_weak(old, newDistance,
+                            memory_order_relaxed)) {
+                        out.push_back(target);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void DeltaStepping::queueImproved() {
+    for (vector<u32>& out : improved) {
+        for (u32 node : out) {
+            u64 bucket = bucketOf(tentative[node].load(memory_order_relaxed));
+            if (queuedIn[node] == bucket) continue;
+
+            queuedIn[node] = bucket;
+            if (bucket >= buckets.size()) buckets.resize(bucket + 1);
+            buckets[bucket].push_back(node);
+        }
+        out.clear();
+    }
+}
+
+bool DeltaStepping::nextFrontier(const vector<u32>& ends) {
+    frontier.clear();
+
+    while (current < buckets.size()) {
+        for (u32 node : buckets[current]) {
+            if (queuedIn[node] == current) {
+                queuedIn[node] = NOT_QUEUED;
+                frontier.push_back(node);
+            }
+        }
+        buckets[current].clear();
+        if (!frontier.empty()) return true;
+
+        // Every node closer than the next bucket is settled
+        ++current;
+        bool settled = true;
+        for (u32 end : ends) {
+            if (tentative[end].load(memory_order_relaxed) >= current * delta) {
+                settled = false;
+                break;
+            }
+        }
+        if (settled) return false;
+    }
+
+    return false;
+}
+
+void DeltaStepping::distances(u64 start, const vector<u64>& endVec, vector<double>& result) {
+    u32 n = graph.numNodes();
+    for (u32 v = 0; v < n; ++v) {
+        tentative[v].store(DBL_MAX, memory_order_relaxed);
+    }
+    fill(queuedIn.begin(), queuedIn.end(), NOT_QUEUED);
+    for (auto& bucket : buckets) {
+        bucket.clear();
+    }
+    current = 0;
+    rounds = 0;
+
+    vector<u32> ends;
+    for (u64 end : endVec) {
+        u32 idx = graph.getIndex(end);
+        if (idx != Graph<OsmNode>::INVALID_INDEX) ends.push_back(idx);
+    }
+
+    u32 startIdx = graph.getIndex(start);
+    tentative[startIdx].store(0, memory_order_relaxed);
+    improved[0].push_back(startIdx);
+    queueImproved();
+
+    // Thread 0 prepares each round while the workers wait at the first barrier
+    next = 0;
+    while (nextFrontier(ends)) {
+        barrier.wait();
+        scanFrontier(0);
+        barrier.wait();
+
+        ++rounds;
+        queueImproved();
+        next = 0;
+    }
+
+    result.clear();
+    for (u64 end : endVec) {
+        u32 idx = graph.getIndex(end);
+        result.push_back(idx == Graph<OsmNode>::INVALID_INDEX ? DBL_MAX
+            : tentative[idx].load(memory_order_relaxed));
+    }
+}
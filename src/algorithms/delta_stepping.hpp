@@ -0,0 +1,92 @@
+#ifndef DELTA_STEPPING_H
+#define DELTA_STEPPING_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../graph.hpp"
+#include "../osm/osm.hpp"
+#include "../types.hpp"
+#include "../utils.hpp"
+
+// Single-source shortest paths with delta-stepping (Meyer and Sanders), which
+// parallelizes a single search. Nodes are kept in buckets of width delta by
+// tentative distance, and all the nodes of the first non-empty bucket are
+// scanned at once by every thread. Nodes whose distance improves to a value in
+// the same bucket are scanned again in another round, so a small delta scans
+// nodes about once, like Dijkstra's algorithm, and a large one gives each
+// round more nodes to share between the threads.
+//
+// Node indices are those of the graph, using the weights of its active metric.
+// The other threads are started once and wait on a barrier between rounds and
+// between searches, so a search only costs as many thread wake-ups as rounds.
+class DeltaStepping {
+    public:
+        // A delta of 0 picks DEFAULT_DELTA_EDGES times the mean edge weight
+        DeltaStepping(const Graph<OsmNode>& graph, u32 numThreads, double delta = 0);
+        ~DeltaStepping();
+
+        DeltaStepping(const DeltaStepping&) = delete;
+        DeltaStepping& operator=(const DeltaStepping&) = delete;
+
+        static constexpr double DEFAULT_DELTA_EDGES = 4;
+
+        // Distances from start to every end (DBL_MAX if unreachable), stopping
+        // once every end is settled
+        void distances(u64 start, const std::vector<u64>& endVec, std::vector<double>& result);
+
+        double getDelta() const {
+            return delta;
+        }
+
+        // Rounds (scans of a bucket's nodes) made by the last search
+        u32 numRounds() const {
+            return rounds;
+        }
+    private:
+        static constexpr u64 NOT_QUEUED = UINT64_MAX;
+
+        // Frontier nodes taken by a thread at a time
+        static constexpr size_t CHUNK_SIZE = 64;
+
+        const Graph<OsmNode>& graph;
+        u32 numThreads;
+        double delta;
+        u32 rounds = 0;
+
+        std::unique_ptr<std::atomic<double>[]> tentative;
+
+        // Bucket each node was last queued in, entries in other buckets being
+        // stale
+        std::vector<u64> queuedIn;
+        std::vector<std::vector<u32>> buckets;
+        u64 current = 0;
+
+        // Nodes being scanned, and nodes improved by each thread in this round
+        std::vector<u32> frontier;
+        std::vector<std::vector<u32>> improved;
+
+        // The calling thread scans as thread 0 alongside the workers. Every
+        // round, all threads pass the barrier once before scanning and once
+        // after, and the workers return once stopping is set before the first.
+        Barrier barrier;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> next;
+        bool stopping = false;
+
+        void workerLoop(u32 thread);
+
+        u64 bucketOf(double distance) const {
+            return (u64) (distance / delta);
+        }
+
+        void scanFrontier(u32 thread);
+        void queueImproved();
+
+        // Takes the nodes of the first non-empty bucket as the next frontier.
+        // Returns false when there are none left or every end is settled.
+        bool nextFrontier(const std::vector<u32>& ends);
+};
+
+#endif // DELTA_STEPPING_H
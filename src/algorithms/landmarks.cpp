@@ -0,0 +1,282 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include "landmarks.hpp"
+#include "../utils.hpp"
+
+using namespace std;
+using chrono::high_resolution_clock;
+using chrono::milliseconds;
+
+static const char LANDMARKS_MAGIC[8] = {'C', 'V', 'R', 'P', 'A', 'L', 'T', 'L'};
+static const u32 LANDMARKS_VERSION = 1;
+
+struct LandmarksFileHeader {
+    char magic[8];
+    u32 version;
+    u32 numLandmarks;
+    u64 fingerprint;
+    u64 numNodes;
+};
+
+// Random roots tried in a row by the avoid strategy before giving up
+static const u32 MAX_FAILED_ROOTS = 10;
+
+using HeapEntry = pair<double, u32>;
+using MinHeap = priority_queue<HeapEntry, vector<HeapEntry>, greater<HeapEntry>>;
+
+// Distances from source to every node and, if requested, the shortest path tree
+// and the order in which nodes were settled
+template <typename G>
+static void oneToAll(const G& graph, u32 source, vector<double>& distances,
+        vector<u32>* parents = nullptr, vector<u32>* order = nullptr) {
+    distances.assign(graph.numNodes(), DBL_MAX);
+    if (parents) parents->assign(distances.size(), Graph<OsmNode>::INVALID_INDEX);
+    if (order) order->clear();
+
+    MinHeap heap;
+    distances[source] = 0;
+    heap.push({0, source});
+
+    while (!heap.empty()) {
+        auto [distance, v] = heap.top();
+        heap.pop();
+        if (distance > distances[v]) continue;
+        if (order) order->push_back(v);
+
+        for (u32 e = graph.edgesBegin(v); e != graph.edgesEnd(v); ++e) {
+            u32 target = graph.getTarget(e);
+            double newDistance = distance + graph.getWeight(e);
+            if (newDistance < distances[target]) {
+                distances[target] = newDistance;
+                if (parents) (*parents)[target] = v;
+                heap.push({newDistance, target});
+            }
+        }
+    }
+}
+
+void Landmarks::select(const Graph<OsmNode>& graph, u32 count, LandmarkSelection strategy,
+        bool printLogs) {
+    auto start = high_resolution_clock::now();
+
+    u32 n = graph.numNodes();
+    fingerprint = graph.fingerprint();
+    landmarks.clear();
+    fromLandmarks.clear();
+    toLandmarks.clear();
+    if (n == 0) return;
+
+    const Graph<OsmNode>& forward = graph;
+    ReverseGraph<OsmNode> reverse(graph);
+
+    // Fixed seed, so that the same graph always gets the same landmarks
+    default_random_engine randomEngine(n);
+    uniform_int_distribution<u32> randomNode(0, n - 1);
+
+    vector<vector<double>> from, to;
+    vector<double> distances;
+    vector<u32> parents, order;
+
+    auto addLandmark = [&](u32 landmark) {
+        landmarks.push_back(landmark);
+        from.emplace_back();
+        to.emplace_back();
+        oneToAll(forward, landmark, from.back());
+        oneToAll(reverse, landmark, to.back());
+    };
+
+    auto bound = [&](u32 node, u32 target) {
+        double b = 0;
+        for (size_t l = 0; l < landmarks.size(); ++l) {
+            if (from[l][node] != DBL_MAX && from[l][target] != DBL_MAX) {
+                b = max(b, from[l][target] - from[l][node]);
+            }
+            if (to[l][node] != DBL_MAX && to[l][target] != DBL_MAX) {
+                b = max(b, to[l][node] - to[l][target]);
+            }
+        }
+        return b;
+    };
+
+    // Both strategies start from the node with the longest round trip from a
+    // random node. Roots outside the main component of the road graph would
+    // only reach a few nodes both ways, so the root reaching most is kept.
+    u32 first = 0, mostConnected = 0;
+    vector<double> reverseDistances;
+    for (u32 attempt = 0; attempt < MAX_FAILED_ROOTS && mostConnected <= n / 2; ++attempt) {
+        u32 candidate = randomNode(randomEngine);
+        oneToAll(forward, candidate, distances);
+        oneToAll(reverse, candidate, reverseDistances);
+
+        u32 connected = 0, farthest = candidate;
+        for (u32 v = 0; v < n; ++v) {
+            if (distances[v] == DBL_MAX || reverseDistances[v] == DBL_MAX) continue;
+            ++connected;
+            if (distances[v] + reverseDistances[v] >
+                    distances[farthest] + reverseDistances[farthest]) {
+                farthest = v;
+            }
+        }
+
+        if (connected > mostConnected) {
+            mostConnected = connected;
+            first = farthest;
+        }
+    }
+    addLandmark(first);
+
+    vector<double> closest(n, DBL_MAX);
+    vector<double> sizes(n);
+    vector<bool> covered(n);
+    u32 failedRoots = 0;
+
+    while (landmarks.size() < min(count, n)) {
+        u32 next = Graph<OsmNode>::INVALID_INDEX;
+
+        if (strategy == FARTHEST_LANDMARKS) {
+            // Node whose distance to the closest landmark (in either direction,
+            // among the nodes connected to it) is largest
+            const vector<double>& f = from.back();
+            const vector<double>& t = to.back();
+            double best = -1;
+            for (u32 v = 0; v < n; ++v) {
+                if (f[v] != DBL_MAX && t[v] != DBL_MAX) {
+                    closest[v] = min(closest[v], f[v] + t[v]);
+                }
+                if (closest[v] != DBL_MAX && closest[v] > best) {
+                    best = closest[v];
+                    next = v;
+                }
+            }
+        }
+        else {
+            // Weight each node of the shortest path tree of a random root by how
+            // much its bound from the root falls short, sum the weights of each
+            // subtree without a landmark and walk down the heaviest subtrees
+            u32 root = randomNode(randomEngine);
+            oneToAll(forward, root, distances, &parents, &order);
+
+            fill(sizes.begin(), sizes.end(), 0);
+            fill(covered.begin(), covered.end(), false);
+            for (u32 landmark : landmarks) {
+                covered[landmark] = true;
+            }
+
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                u32 v = *it;
+                if (covered[v]) {
+                    sizes[v] = 0;
+                }
+                else {
+                    sizes[v] += distances[v] - bound(root, v);
+                }
+
+                u32 parent = parents[v];
+                if (parent != Graph<OsmNode>::INVALID_INDEX) {
+                    if (covered[v]) covered[parent] = true;
+                    else sizes[parent] += sizes[v];
+                }
+            }
+
+            // Heaviest child of each node
+            vector<u32> heaviest(n, Graph<OsmNode>::INVALID_INDEX);
+            for (u32 v : order) {
+                u32 parent = parents[v];
+                if (parent != Graph<OsmNode>::INVALID_INDEX && sizes[v] > 0 &&
+                        (heaviest[parent] == Graph<OsmNode>::INVALID_INDEX ||
+                        sizes[v] > sizes[heaviest[parent]])) {
+                    heaviest[parent] = v;
+                }
+            }
+
+            u32 v = root;
+            for (u32 u : order) {
+                if (sizes[u] > sizes[v]) v = u;
+            }
+            if (sizes[v] > 0) {
+                while (heaviest[v] != Graph<OsmNode>::INVALID_INDEX) {
+                    v = heaviest[v];
+                }
+                next = v;
+            }
+        }
+
+        // Every node reached already has a landmark in its subtree, or is not
+        // connected to the previous landmarks. Avoid retries with other roots.
+        if (next == Graph<OsmNode>::INVALID_INDEX ||
+                find(landmarks.begin(), landmarks.end(), next) != landmarks.end()) {
+            if (strategy == AVOID_LANDMARKS && ++failedRoots < MAX_FAILED_ROOTS) continue;
+            break;
+        }
+        failedRoots = 0;
+        addLandmark(next);
+    }
+
+    u32 k = landmarks.size();
+    fromLandmarks.resize((size_t) n * k);
+    toLandmarks.resize((size_t) n * k);
+    for (u32 v = 0; v < n; ++v) {
+        for (u32 l = 0; l < k; ++l) {
+            fromLandmarks[(size_t) v * k + l] = from[l][v];
+            toLandmarks[(size_t) v * k + l] = to[l][v];
+        }
+    }
+
+    auto end = high_resolution_clock::now();
+    if (printLogs) {
+        cout << "Selected " << k << " landmarks in " << interval<milliseconds>(start, end)
+            << "ms\n";
+    }
+}
+
+bool Landmarks::read(const char* path, const Graph<OsmNode>& graph) {
+    ifstream ifs(path, ios::binary);
+    if (!ifs.good()) return false;
+
+    LandmarksFileHeader header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    if (memcmp(header.magic, LANDMARKS_MAGIC, sizeof(LANDMARKS_MAGIC)) != 0 ||
+            header.version != LANDMARKS_VERSION || header.numNodes != graph.numNodes() ||
+            header.fingerprint != graph.fingerprint()) {
+        return false;
+    }
+
+    size_t tableSize = header.numNodes * header.numLandmarks;
+    landmarks.resize(header.numLandmarks);
+    fromLandmarks.resize(tableSize);
+    toLandmarks.resize(tableSize);
+
+    ifs.read(reinterpret_cast<char*>(landmarks.data()), landmarks.size() * sizeof(u32));
+    ifs.read(reinterpret_cast<char*>(fromLandmarks.data()), tableSize * sizeof(double));
+    ifs.read(reinterpret_cast<char*>(toLandmarks.data()), tableSize * sizeof(double));
+
+    if (!ifs) {
+        *this = Landmarks();
+        return false;
+    }
+
+    fingerprint = header.fingerprint;
+    return true;
+}
+
+void Landmarks::write(const char* path) const {
+    LandmarksFileHeader header = {};
+    memcpy(header.magic, LANDMARKS_MAGIC, sizeof(LANDMARKS_MAGIC));
+    header.version = LANDMARKS_VERSION;
+    header.numLandmarks = landmarks.size();
+    header.fingerprint = fingerprint;
+    header.numNodes = landmarks.empty() ? 0 : fromLandmarks.size() / landmarks.size();
+
+    ofstream ofs(path, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(landmarks.data()), landmarks.size() * sizeof(u32));
+    ofs.write(reinterpret_cast<const char*>(fromLandmarks.data()), fromLandmarks.size() * sizeof(double));
+    ofs.write(reinterpret_cast<const char*>(toLandmarks.data()), toLandmarks.size() * sizeof(double));
+    ofs.close();
+}
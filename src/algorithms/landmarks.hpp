@@ -0,0 +1,72 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+#include "../graph.hpp"
+#include "../osm/osm.hpp"
+#include "../types.hpp"
+
+enum LandmarkSelection {FARTHEST_LANDMARKS, AVOID_LANDMARKS};
+
+// Landmarks for A* searches (ALT). The distances from and to every landmark
+// give, by the triangle inequality, a lower bound on the distance between any
+// two nodes, which is much tighter than the straight-line distance on road
+// networks with rivers, one-way streets or travel time weights.
+//
+// Node indices are those of the graph the landmarks were selected in, using
+// the weights of its active metric.
+class Landmarks {
+    public:
+        Landmarks() {}
+
+        // Farthest picks each landmark as far as possible from the previous
+        // ones. Avoid picks it in the region of the shortest path tree of a
+        // random node where the current landmarks give the worst bounds.
+        void select(const Graph<OsmNode>& graph, u32 count,
+            LandmarkSelection strategy = AVOID_LANDMARKS, bool printLogs = false);
+
+        // Loads landmarks written by write. Returns false if the file does not
+        // exist or was made for a different graph.
+        bool read(const char* path, const Graph<OsmNode>& graph);
+
+        void write(const char* path) const;
+
+        u32 numLandmarks() const {
+            return landmarks.size();
+        }
+
+        const std::vector<u32>& getNodes() const {
+            return landmarks;
+        }
+
+        // Lower bound on the distance from node to target
+        double lowerBound(u32 node, u32 target) const {
+            u32 k = landmarks.size();
+            const double* nodeFrom = fromLandmarks.data() + (size_t) node * k;
+            const double* nodeTo = toLandmarks.data() + (size_t) node * k;
+            const double* targetFrom = fromLandmarks.data() + (size_t) target * k;
+            const double* targetTo = toLandmarks.data() + (size_t) target * k;
+
+            double bound = 0;
+            for (u32 l = 0; l < k; ++l) {
+                if (nodeFrom[l] != DBL_MAX && targetFrom[l] != DBL_MAX) {
+                    bound = std::max(bound, targetFrom[l] - nodeFrom[l]);
+                }
+                if (nodeTo[l] != DBL_MAX && targetTo[l] != DBL_MAX) {
+                    bound = std::max(bound, nodeTo[l] - targetTo[l]);
+                }
+            }
+            return bound;
+        }
+    private:
+        u64 fingerprint = 0;
+        std::vector<u32> landmarks;
+
+        // Distances from and to each landmark (DBL_MAX if unreachable), with
+        // the entries of every landmark for a node stored together
+        std::vector<double> fromLandmarks, toLandmarks;
+};
+
+#endif // LANDMARKS_H
@@ -9,7 +9,10 @@
 #include "../data_structures/kd_tree.hpp"
 #include "../data_structures/quadtree.hpp"
 #include "../data_structures/binary_heap.hpp"
+#include "../data_structures/dial_queue.hpp"
 #include "../data_structures/fibonacci_heap.hpp"
+#include "../data_structures/radix_heap.hpp"
+#include "../osm/osm.hpp"
 #include "../utils.hpp"
 
 using namespace std;
@@ -135,8 +138,8 @@ void quadtreeRealDataComplexityAnalysis(u32 seed) {
     Quadtree quadtree(boundary);
 
     // Insert nodes into Quadtree
-    for (const pair<u64, OsmNode>& node : data.graph.getNodes()) {
-        quadtree.insert(data.graph.getNode(node.first));
+    for (const OsmNode& node : data.graph.getNodes()) {
+        quadtree.insert(node);
     }
 
     srand(seed);
@@ -158,6 +161,77 @@ void quadtreeRealDataComplexityAnalysis(u32 seed) {
     cout << nnQuadtree << endl;
 }
 
+// Priority queue operation performed by Dijkstra's algorithm
+struct HeapOperation {
+    enum {INSERT, DECREASE_KEY, EXTRACT_MIN} type;
+    u32 node;
+    double key;
+};
+
+// Records the operations of a one-to-all Dijkstra search from source
+static void recordDijkstraTrace(const Graph<OsmNode>& g, u32 source,
+        vector<HeapOperation>& trace) {
+    u32 n = g.numNodes();
+    BinaryHeap<u32> heap;
+    vector<u64> ids(n);
+    vector<double> distances(n, DBL_MAX);
+
+    distances[source] = 0;
+    ids[source] = heap.insert(source, 0);
+    trace.push_back({HeapOperation::INSERT, source, 0});
+
+    while (!heap.empty()) {
+        u32 node = heap.extractMin();
+        trace.push_back({HeapOperation::EXTRACT_MIN, node, 0});
+
+        for (u32 e = g.edgesBegin(node); e != g.edgesEnd(node); ++e) {
+            u32 target = g.getTarget(e);
+            double distance = distances[node] + g.getWeight(e);
+            if (distance < distances[target]) {
+                bool seen = distances[target] != DBL_MAX;
+                distances[target] = distance;
+
+                if (seen) {
+                    heap.decreaseKey(ids[target], distance);
+                    trace.push_back({HeapOperation::DECREASE_KEY, target, distance});
+                }
+                else {
+                    ids[target] = heap.insert(target, distance);
+                    trace.push_back({HeapOperation::INSERT, target, distance});
+                }
+            }
+        }
+    }
+}
+
+// Replays a trace, returning the time it took in nanoseconds. Ties may be
+// extracted in another order than when recording, so keys are only decreased
+// for nodes that are still in the queue.
+template <typename Heap, typename Handle>
+static u64 replayTrace(const vector<HeapOperation>& trace, u32 numNodes, Heap& heap) {
+    vector<Handle> handles(numNodes);
+    vector<bool> inHeap(numNodes, false);
+
+    auto start = high_resolution_clock::now();
+    for (const HeapOperation& op : trace) {
+        switch (op.type) {
+            case HeapOperation::INSERT:
+                handles[op.node] = heap.insert(op.node, op.key);
+                inHeap[op.node] = true;
+                break;
+            case HeapOperation::DECREASE_KEY:
+                if (inHeap[op.node]) heap.decreaseKey(handles[op.node], op.key);
+                break;
+            case HeapOperation::EXTRACT_MIN:
+                inHeap[heap.extractMin()] = false;
+                break;
+        }
+    }
+    auto end = high_resolution_clock::now();
+
+    return interval<nanoseconds>(start, end);
+}
+
 void heapComplexityAnalysis(u32 seed, bool writeToFile) {
     static const size_t size = 8;
     static const double minKey = 0, maxKey = 500;
@@ -327,4 +401,46 @@ void heapComplexityAnalysis(u32 seed, bool writeToFile) {
         cout << setw(10) << numNodes[i] << " | " << setw(10) << decreaseKeyBin[i] 
             << " | " << setw(10) << decreaseKeyFib[i] << "\n";
     }
+
+    // The synthetic workloads above have random keys, whereas Dijkstra's keys
+    // are monotone, which the radix heap and Dial buckets rely on
+    static const char* traceOsmFile = "../data/pa.xml";
+    static const u32 traceSearches = 20;
+
+    OsmXmlData data = parseOsmXml(traceOsmFile);
+    u32 n = data.graph.numNodes();
+    if (n == 0) return;
+
+    u64 traceBin = 0, traceFib = 0, traceRadix = 0, traceDial = 0;
+    size_t traceOperations = 0;
+    uniform_int_distribution<u32> randNode(0, n - 1);
+
+    for (u32 _ = 0; _ < traceSearches; ++_) {
+        vector<HeapOperation> trace;
+        recordDijkstraTrace(data.graph, randNode(eng), trace);
+        traceOperations += trace.size();
+
+        BinaryHeap<u32> binHeap;
+        FibonacciHeap<u32> fibHeap;
+        RadixHeap<u32> radixHeap;
+        DialQueue<u32> dialQueue;
+        traceBin += replayTrace<BinaryHeap<u32>, u64>(trace, n, binHeap);
+        traceFib += replayTrace<FibonacciHeap<u32>, FHNode<u32>*>(trace, n, fibHeap);
+        traceRadix += replayTrace<RadixHeap<u32>, u64>(trace, n, radixHeap);
+        traceDial += replayTrace<DialQueue<u32>, u64>(trace, n, dialQueue);
+    }
+
+    cout << "\nDijkstra traces (" << traceSearches << " one-to-all searches, "
+        << traceOperations / traceSearches << " operations each)\n";
+    cout << string(50, '-') << "\n";
+    cout << setw(10) << "Queue" << " | " << setw(10) << "Total (ms)" << " | "
+        << setw(10) << "Op (ns)" << "\n";
+
+    array<pair<const char*, u64>, 4> traceTimes = {{
+        {"Bin", traceBin}, {"Fib", traceFib}, {"Radix", traceRadix}, {"Dial", traceDial}
+    }};
+    for (const auto& p : traceTimes) {
+        cout << setw(10) << p.first << " | " << setw(10) << p.second / 1000000 << " | "
+            << setw(10) << p.second / max<size_t>(1, traceOperations) << "\n";
+    }
 }
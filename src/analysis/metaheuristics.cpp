@@ -30,7 +30,10 @@ CvrpInstance loadInstance(const string& name) {
     ifstream ifs("../cvrp-" + name + ".json");
     CvrpInstance instance(ifs);
     ifs.close();
-    instance.readDistanceMatrixFromFile(("dm-" + name + ".txt").c_str());
+    if (!instance.readDistanceMatrixFromFile(("dm-" + name + ".txt").c_str())) {
+        cerr << "Error: distance matrix 'dm-" << name << ".txt' is missing or does not match the instance." << endl;
+        exit(1);
+    }
     return instance;
 }
 
@@ -1,8 +1,22 @@
+#include <array>
 
 #include <chrono>
 #include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "real_data.hpp"
 #include "../algorithms/a_star.hpp"
+#include "../algorithms/contraction_hierarchy.hpp"
+#include "../algorithms/landmarks.hpp"
+#include "../osm/preprocessing.hpp"
 #include "../utils.hpp"
 
 using namespace std;
@@ -11,15 +25,22 @@ using chrono::high_resolution_clock;
 using chrono::milliseconds;
 
 void shortestPathDataStructureAnalysis() {
+    static const array<pair<ShortestPathDataStructure, const char*>, 4> dataStructures = {{
+        {BINARY_HEAP, "Binary Heap"},
+        {FIBONACCI_HEAP, "Fibonacci Heap"},
+        {QUATERNARY_HEAP, "4-ary Heap (lazy deletion)"},
+        {OCTONARY_HEAP, "8-ary Heap (lazy deletion)"},
+    }};
+
     auto printPaths = [](const OsmXmlData& data, CvrpInstance& instance,
-            const MapMatchingResult& result, ShortestPathDataStructure dataStructure) {
-        const char* dsName = dataStructure == BINARY_HEAP ? "Binary Heap" : "Fibonacci Heap";
-        
-        auto start = high_resolution_clock::now();
-        calculateShortestPaths(data, instance, result, dataStructure, false, 12);
-        auto end = high_resolution_clock::now();
+            const MapMatchingResult& result) {
+        for (const auto& [dataStructure, dsName] : dataStructures) {
+            auto start = high_resolution_clock::now();
+            calculateShortestPaths(data, instance, result, dataStructure, false, 12);
+            auto end = high_resolution_clock::now();
 
-        cout << dsName << "\n" << interval<chrono::milliseconds>(start, end) << endl;
+            cout << dsName << "\n" << interval<chrono::milliseconds>(start, end) << endl;
+        }
     };
 
     {
@@ -28,8 +49,7 @@ void shortestPathDataStructureAnalysis() {
         CvrpInstance instance(ifs);
         MapMatchingResult result = matchLocations(data, instance, KD_TREE, true);
 
-        printPaths(data, instance, result, BINARY_HEAP);
-        printPaths(data, instance, result, FIBONACCI_HEAP);
+        printPaths(data, instance, result);
     }
 
     {
@@ -38,8 +58,7 @@ void shortestPathDataStructureAnalysis() {
         CvrpInstance instance(ifs);
         MapMatchingResult result = matchLocations(data, instance, KD_TREE, true);
 
-        printPaths(data, instance, result, BINARY_HEAP);
-        printPaths(data, instance, result, FIBONACCI_HEAP);
+        printPaths(data, instance, result);
     }
 
     {
@@ -48,8 +67,7 @@ void shortestPathDataStructureAnalysis() {
         CvrpInstance instance(ifs);
         MapMatchingResult result = matchLocations(data, instance, KD_TREE, true);
 
-        printPaths(data, instance, result, BINARY_HEAP);
-        printPaths(data, instance, result, FIBONACCI_HEAP);
+        printPaths(data, instance, result);
     }
 }
 
@@ -71,17 +89,393 @@ void parallelismAnalysis() {
 
     ofstream fibOfs("sp_fib_total.txt"), binOfs("sp_bin_total.txt");
 
+    // Speedups are relative to the single-threaded time
+    u64 baseMs = 1;
+
     cout << "FIBONACCI HEAP\n--------------\n";
     for (size_t i = 1; i <= 16; ++i) {
         auto ms = calcPaths(data, instance, result, FIBONACCI_HEAP, i, "shortest_paths_f" + to_string(i) + ".txt");
-        cout << "[ " << i << " THREADS ] - " << ms << "\n";
+        if (i == 1) baseMs = max<u64>(ms, 1);
+        cout << "[ " << i << " THREADS ] - " << ms << " (speedup " << (double) baseMs / max<u64>(ms, 1) << ")\n";
         fibOfs << ms << " ";
     }
 
     cout << "BINARY HEAP\n-----------\n";
     for (size_t i = 1; i <= 16; ++i) {
         auto ms = calcPaths(data, instance, result, BINARY_HEAP, i, "shortest_paths_b" + to_string(i) + ".txt");
-        cout << "[ " << i << " THREADS ] - " << ms << "\n";
+        if (i == 1) baseMs = max<u64>(ms, 1);
+        cout << "[ " << i << " THREADS ] - " << ms << " (speedup " << (double) baseMs / max<u64>(ms, 1) << ")\n";
         binOfs << ms << " ";
     }
 }
+
+void osmParsingAnalysis() {
+    static const array<const char*, 3> osmFiles = {
+        "../cvrp_belem.xml", "../cvrp_brasilia.xml", "../cvrp_rio.xml"
+    };
+
+    static const u32 numThreads = max(2u, thread::hardware_concurrency());
+
+    // Each parse runs in a child process so that its peak RSS is not affected
+    // by the memory used by previous parses
+    auto measure = [](const char* path, const string& parser, function<OsmXmlData()> parse) {
+        cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            auto start = high_resolution_clock::now();
+            OsmXmlData data = parse();
+            auto end = high_resolution_clock::now();
+
+            cout << setw(22) << path << " | " << setw(13) << parser << " | " << setw(10)
+                << interval<milliseconds>(start, end) << " | " << setw(10)
+                << data.graph.numNodes() << " | " << flush;
+            _exit(0);
+        }
+
+        int status;
+        struct rusage usage;
+        wait4(pid, &status, 0, &usage);
+        cout << setw(10) << usage.ru_maxrss / 1024 << endl;
+    };
+
+    cout << setw(22) << "File" << " | " << setw(13) << "Parser" << " | " << setw(10)
+        << "Time (ms)" << " | " << setw(10) << "Nodes" << " | " << setw(10) << "Peak (MB)" << "\n";
+    cout << string(79, '-') << "\n";
+
+    for (const char* path : osmFiles) {
+        measure(path, "DOM", [path] { return parseOsmXmlDom(path); });
+        measure(path, "Streaming", [path] { return parseOsmXml(path); });
+        measure(path, "Parallel (" + to_string(numThreads) + ")", [path] {
+            return parseOsmXml(path, numThreads);
+        });
+    }
+}
+
+// Counts last level cache misses of the calling thread and the threads it
+// creates while the counter is enabled. Requires perf events to be available
+// (see /proc/sys/kernel/perf_event_paranoid).
+class CacheMissCounter {
+    public:
+        CacheMissCounter() {
+            struct perf_event_attr attr = {};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        ~CacheMissCounter() {
+            if (fd >= 0) close(fd);
+        }
+
+        bool available() const {
+            return fd >= 0;
+        }
+
+        void start() {
+            if (fd < 0) return;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+
+        u64 stop() {
+            if (fd < 0) return 0;
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            u64 count = 0;
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+            return count;
+        }
+    private:
+        int fd;
+};
+
+void nodeOrderingAnalysis() {
+    static const array<pair<NodeOrdering, const char*>, 3> orderings = {{
+        {OSM_ORDER, "OSM"}, {HILBERT_CURVE, "Hilbert"}, {REVERSE_CUTHILL_MCKEE, "RCM"}
+    }};
+
+    OsmXmlData original = parseOsmXml("../cvrp_rio.xml");
+    ifstream ifs("../cvrp-2-rj-17.json");
+    CvrpInstance instance(ifs);
+    MapMatchingResult result = matchLocations(original, instance, KD_TREE);
+
+    cout << setw(10) << "Ordering" << " | " << setw(10) << "Time (ms)" << " | "
+        << setw(15) << "Cache misses" << "\n";
+    cout << string(42, '-') << "\n";
+
+    for (const auto& p : orderings) {
+        OsmXmlData data = original;
+        reorderNodes(data, p.first);
+
+        CacheMissCounter counter;
+        counter.start();
+        auto start = high_resolution_clock::now();
+        calculateShortestPaths(data, instance, result, BINARY_HEAP, false, 1);
+        auto end = high_resolution_clock::now();
+        u64 misses = counter.stop();
+
+        cout << setw(10) << p.second << " | " << setw(10) << interval<milliseconds>(start, end)
+            << " | " << setw(15) << (counter.available() ? to_string(misses) : "n/a") << endl;
+    }
+}
+
+void matrixEngineAnalysis() {
+    static const array<pair<const char*, const char*>, 3> regions = {{
+        {"../cvrp_belem.xml", "../cvrp-0-pa-34.json"},
+        {"../cvrp_brasilia.xml", "../cvrp-0-df-12.json"},
+        {"../cvrp_rio.xml", "../cvrp-2-rj-17.json"}
+    }};
+
+    static const u32 numThreads = 12;
+
+    cout << setw(22) << "File" << " | " << setw(15) << "Engine" << " | " << setw(10)
+        << "Time (ms)" << " | " << setw(10) << "Rows/s" << "\n";
+    cout << string(66, '-') << "\n";
+
+    for (const auto& region : regions) {
+        OsmXmlData data = parseOsmXml(region.first);
+        ifstream ifs(region.second);
+        CvrpInstance instance(ifs);
+        MapMatchingResult result = matchLocations(data, instance, KD_TREE);
+
+        size_t numRows = 1 + instance.getDeliveries().size();
+        auto measure = [&](const char* engine, function<void()> run) {
+            auto start = high_resolution_clock::now();
+            run();
+            auto end = high_resolution_clock::now();
+
+            u64 ms = interval<milliseconds>(start, end);
+            cout << setw(22) << region.first << " | " << setw(15) << engine << " | "
+                << setw(10) << ms << " | " << setw(10) << numRows * 1000 / max<u64>(ms, 1) << endl;
+        };
+
+        measure("Fibonacci Heap", [&] {
+            calculateShortestPaths(data, instance, result, FIBONACCI_HEAP, false, numThreads);
+        });
+        measure("Binary Heap", [&] {
+            calculateShortestPaths(data, instance, result, BINARY_HEAP, false, numThreads);
+        });
+        measure("Batched", [&] {
+            calculateShortestPathsBatched(data, instance, result, false, numThreads);
+        });
+
+        // The hierarchy is built once per region, so it is timed separately
+        ContractionHierarchy ch;
+        measure("CH build", [&] { ch.build(data.graph); });
+        measure("CH queries", [&] {
+            calculateShortestPathsHierarchy(data, ch, instance, result, false, numThreads);
+        });
+        measure("CH buckets", [&] {
+            calculateShortestPathsBuckets(data, ch, instance, result, false, numThreads);
+        });
+        measure("PHAST", [&] {
+            calculateShortestPathsPhast(data, ch, instance, result, false, numThreads);
+        });
+    }
+}
+
+void landmarkAnalysis() {
+    static const u32 numLandmarks = 16;
+    static const size_t maxPairs = 500;
+
+    OsmXmlData data = parseOsmXml("../cvrp_rio.xml");
+    ifstream ifs("../cvrp-2-rj-17.json");
+    CvrpInstance instance(ifs);
+    MapMatchingResult result = matchLocations(data, instance, KD_TREE);
+
+    // Legs between consecutive deliveries, as drawn by showSolution
+    vector<pair<u64, u64>> pairs;
+    for (size_t i = 0; i + 1 < result.deliveryNodes.size() && pairs.size() < maxPairs; ++i) {
+        pairs.push_back({result.deliveryNodes[i], result.deliveryNodes[i + 1]});
+    }
+
+    cout << setw(15) << "Heuristic" << " | " << setw(10) << "Setup (ms)" << " | " << setw(10)
+        << "Query (us)" << " | " << setw(10) << "Settled" << " | " << setw(10) << "Mismatches" << "\n";
+    cout << string(67, '-') << "\n";
+
+    vector<double> expected;
+    auto measure = [&](const char* name, u64 setupMs,
+            function<pair<list<u64>, double>(u64, u64, u32*)> search) {
+        u64 totalUs = 0, totalSettled = 0;
+        size_t mismatches = 0;
+
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            u32 settled = 0;
+            auto start = high_resolution_clock::now();
+            double distance = search(pairs[i].first, pairs[i].second, &settled).second;
+            auto end = high_resolution_clock::now();
+
+            totalUs += interval<chrono::microseconds>(start, end);
+            totalSettled += settled;
+            if (expected.size() <= i) expected.push_back(distance);
+            else if (abs(distance - expected[i]) > 1e-6 * max(1.0, expected[i])) ++mismatches;
+        }
+
+        size_t n = max<size_t>(1, pairs.size());
+        cout << setw(15) << name << " | " << setw(10) << setupMs << " | " << setw(10)
+            << totalUs / n << " | " << setw(10) << totalSettled / n << " | "
+            << setw(10) << mismatches << endl;
+    };
+
+    measure("Haversine", 0, [&](u64 from, u64 to, u32* settled) {
+        return aStarSearch(data.graph, from, to, costPerMeterBound(data), settled);
+    });
+
+    for (auto strategy : {FARTHEST_LANDMARKS, AVOID_LANDMARKS}) {
+        Landmarks landmarks;
+        auto start = high_resolution_clock::now();
+        landmarks.select(data.graph, numLandmarks, strategy);
+        auto end = high_resolution_clock::now();
+
+        measure(strategy == FARTHEST_LANDMARKS ? "ALT (farthest)" : "ALT (avoid)",
+            interval<milliseconds>(start, end), [&](u64 from, u64 to, u32* settled) {
+                return aStarSearch(data.graph, from, to, landmarks, settled);
+            });
+    }
+}
+
+void bidirectionalSearchAnalysis() {
+    static const array<pair<const char*, const char*>, 3> regions = {{
+        {"../cvrp_belem.xml", "../cvrp-0-pa-34.json"},
+        {"../cvrp_brasilia.xml", "../cvrp-0-df-12.json"},
+        {"../cvrp_rio.xml", "../cvrp-2-rj-17.json"}
+    }};
+
+    static const size_t numPairs = 500;
+
+    cout << setw(22) << "File" << " | " << setw(18) << "Search" << " | " << setw(10)
+        << "Query (us)" << " | " << setw(10) << "Settled" << " | " << setw(10) << "Mismatches" << "\n";
+    cout << string(82, '-') << "\n";
+
+    for (const auto& region : regions) {
+        OsmXmlData data = parseOsmXml(region.first);
+        ifstream ifs(region.second);
+        CvrpInstance instance(ifs);
+        MapMatchingResult result = matchLocations(data, instance, KD_TREE);
+        ReverseGraph<OsmNode> reverse(data.graph);
+
+        // Random pairs of matched locations, the same for every search
+        vector<u64> nodes = result.deliveryNodes;
+        nodes.push_back(result.originNode);
+        default_random_engine randomEngine(numPairs);
+        uniform_int_distribution<size_t> randomLocation(0, nodes.size() - 1);
+
+        vector<pair<u64, u64>> pairs;
+        for (size_t i = 0; i < numPairs; ++i) {
+            pairs.push_back({nodes[randomLocation(randomEngine)], nodes[randomLocation(randomEngine)]});
+        }
+
+        vector<double> expected;
+        auto measure = [&](const char* name, function<pair<list<u64>, double>(u64, u64, u32*)> search) {
+            u64 totalUs = 0, totalSettled = 0;
+            size_t mismatches = 0;
+
+            for (size_t i = 0; i < pairs.size(); ++i) {
+                u32 settled = 0;
+                auto start = high_resolution_clock::now();
+                double distance = search(pairs[i].first, pairs[i].second, &settled).second;
+                auto end = high_resolution_clock::now();
+
+                totalUs += interval<chrono::microseconds>(start, end);
+                totalSettled += settled;
+                if (expected.size() <= i) expected.push_back(distance);
+                else if (abs(distance - expected[i]) > 1e-6 * max(1.0, expected[i])) ++mismatches;
+            }
+
+            cout << setw(22) << region.first << " | " << setw(18) << name << " | " << setw(10)
+                << totalUs / pairs.size() << " | " << setw(10) << totalSettled / pairs.size()
+                << " | " << setw(10) << mismatches << endl;
+        };
+
+        double scale = costPerMeterBound(data);
+        measure("A*", [&](u64 from, u64 to, u32* settled) {
+            return aStarSearch(data.graph, from, to, scale, settled);
+        });
+        measure("Bidir. Dijkstra", [&](u64 from, u64 to, u32* settled) {
+            return bidirectionalDijkstra(data.graph, reverse, from, to, settled);
+        });
+        measure("Bidir. A*", [&](u64 from, u64 to, u32* settled) {
+            return bidirectionalAStarSearch(data.graph, reverse, from, to, scale, settled);
+        });
+    }
+}
+
+void distanceOnlyAnalysis() {
+    static const array<pair<const char*, const char*>, 3> regions = {{
+        {"../cvrp_belem.xml", "../cvrp-0-pa-34.json"},
+        {"../cvrp_brasilia.xml", "../cvrp-0-df-12.json"},
+        {"../cvrp_rio.xml", "../cvrp-2-rj-17.json"}
+    }};
+
+    cout << setw(22) << "File" << " | " << setw(12) << "Paths (ms)" << " | " << setw(14)
+        << "Distances (ms)" << " | " << setw(12) << "List nodes" << "\n";
+    cout << string(70, '-') << "\n";
+
+    for (const auto& region : regions) {
+        OsmXmlData data = parseOsmXml(region.first);
+        ifstream ifs(region.second);
+        CvrpInstance instance(ifs);
+        MapMatchingResult result = matchLocations(data, instance, KD_TREE);
+
+        vector<u64> nodes = result.deliveryNodes;
+        nodes.push_back(result.originNode);
+        SearchWorkspace workspace;
+
+        // Every node of a path is a separate list allocation
+        size_t listNodes = 0;
+        auto start = high_resolution_clock::now();
+        for (u64 source : nodes) {
+            for (const ShortestPathResult& path : dijkstra(data.graph, source, nodes, BINARY_HEAP, workspace)) {
+                listNodes += path.path.size();
+            }
+        }
+        auto end = high_resolution_clock::now();
+        u64 pathsMs = interval<milliseconds>(start, end);
+
+        vector<double> distances;
+        start = high_resolution_clock::now();
+        for (u64 source : nodes) {
+            dijkstraDistances(data.graph, source, nodes, BINARY_HEAP, workspace, distances);
+        }
+        end = high_resolution_clock::now();
+        u64 distancesMs = interval<milliseconds>(start, end);
+
+        cout << setw(22) << region.first << " | " << setw(12) << pathsMs << " | " << setw(14)
+            << distancesMs << " | " << setw(12) << listNodes << endl;
+    }
+}
+
+void deltaSteppingAnalysis() {
+    static const u32 maxThreads = 16;
+
+    // Few deliveries, so that rows alone can't keep every thread busy
+    OsmXmlData data = parseOsmXml("../cvrp_belem.xml");
+    ifstream ifs("../cvrp-0-pa-61.json");
+    CvrpInstance instance(ifs);
+    MapMatchingResult result = matchLocations(data, instance, KD_TREE);
+
+    cout << setw(10) << "Threads" << " | " << setw(10) << "Rows (ms)" << " | " << setw(10)
+        << "Delta (ms)" << "\n";
+    cout << string(36, '-') << "\n";
+
+    for (u32 numThreads = 1; numThreads <= maxThreads; ++numThreads) {
+        auto start = high_resolution_clock::now();
+        calculateShortestPaths(data, instance, result, BINARY_HEAP, false, numThreads);
+        auto end = high_resolution_clock::now();
+        u64 rowsMs = interval<milliseconds>(start, end);
+
+        start = high_resolution_clock::now();
+        calculateShortestPathsDeltaStepping(data, instance, result, false, numThreads);
+        end = high_resolution_clock::now();
+        u64 deltaMs = interval<milliseconds>(start, end);
+
+        cout << setw(10) << numThreads << " | " << setw(10) << rowsMs << " | " << setw(10)
+            << deltaMs << endl;
+    }
+}
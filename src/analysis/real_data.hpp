@@ -4,5 +4,12 @@
 
 void shortestPathDataStructureAnalysis();
 void parallelismAnalysis();
+void osmParsingAnalysis();
+void nodeOrderingAnalysis();
+void matrixEngineAnalysis();
+void landmarkAnalysis();
+void bidirectionalSearchAnalysis();
+void distanceOnlyAnalysis();
+void deltaSteppingAnalysis();
 
 #endif // REAL_DATA_H
@@ -51,16 +51,25 @@ const vector<vector<double>>& CvrpInstance::getDistanceMatrix() const {
     return distanceMatrix;
 }
 
-void CvrpInstance::readDistanceMatrixFromFile(const char* path) {
+bool CvrpInstance::readDistanceMatrixFromFile(const char* path) {
     ifstream ifs(path);
-
-    for (u32 row = 0; row < distanceMatrix.size(); ++row) {
-        for (u32 col = 0; col < distanceMatrix[row].size(); ++col) {
-            ifs >> distanceMatrix[row][col];
+    if (!ifs.good()) return false;
+
+    // Read into a copy, so that a file written for another instance (with more
+    // or fewer locations) is rejected instead of partly read
+    vector<vector<double>> matrix = distanceMatrix;
+    for (u32 row = 0; row < matrix.size(); ++row) {
+        for (u32 col = 0; col < matrix[row].size(); ++col) {
+            if (!(ifs >> matrix[row][col]) || matrix[row][col] < 0) return false;
         }
+        if (matrix[row][row] != 0) return false;
     }
 
-    ifs.close();
+    double extra;
+    if (ifs >> extra) return false;
+
+    distanceMatrix = move(matrix);
+    return true;
 }
 
 void CvrpInstance::writeDistanceMatrixToFile(const char* path) const {
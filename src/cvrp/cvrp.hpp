@@ -23,7 +23,9 @@ class CvrpInstance {
         const std::vector<CvrpDelivery>& getDeliveries() const;
         const std::vector<std::vector<double>>& getDistanceMatrix() const;
 
-        void readDistanceMatrixFromFile(const char* path);
+        // Returns false, leaving the matrix untouched, if the file does not
+        // hold exactly one valid matrix of this instance's size
+        bool readDistanceMatrixFromFile(const char* path);
         void writeDistanceMatrixToFile(const char* path) const;
 
         double routeLength(const std::vector<u64>& route) const;
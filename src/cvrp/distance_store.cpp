@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "distance_store.hpp"
+
+using namespace std;
+
+static const char DISTANCE_STORE_MAGIC[8] = {'C', 'V', 'R', 'P', 'D', 'S', 'T', 'R'};
+static const u32 DISTANCE_STORE_VERSION = 1;
+
+// File layout (native endianness): header, then a StoredDistance per pair in
+// no particular order
+struct DistanceStoreHeader {
+    char magic[8];
+    u32 version;
+    u32 reserved;
+    u64 graphFingerprint;
+    u64 numPairs;
+};
+
+struct StoredDistance {
+    u64 from, to;
+    double distance;
+};
+
+bool DistanceStore::read(const char* path) {
+    ifstream ifs(path, ios::binary);
+    if (!ifs.good()) return false;
+
+    DistanceStoreHeader header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    if (memcmp(header.magic, DISTANCE_STORE_MAGIC, sizeof(DISTANCE_STORE_MAGIC)) != 0 ||
+            header.version != DISTANCE_STORE_VERSION ||
+            header.graphFingerprint != graphFingerprint) {
+        return false;
+    }
+
+    // The pair count is checked against the file size before allocating, so
+    // a truncated or corrupt file is rejected
+    streampos pairsBegin = ifs.tellg();
+    ifs.seekg(0, ios::end);
+    u64 pairsSize = ifs.tellg() - pairsBegin;
+    if (!ifs || pairsSize % sizeof(StoredDistance) != 0 ||
+            header.numPairs != pairsSize / sizeof(StoredDistance)) {
+        return false;
+    }
+    ifs.seekg(pairsBegin);
+
+    vector<StoredDistance> pairs(header.numPairs);
+    ifs.read(reinterpret_cast<char*>(pairs.data()), pairs.size() * sizeof(StoredDistance));
+    if (!ifs) return false;
+
+    distances.reserve(distances.size() + pairs.size());
+    for (const StoredDistance& pair : pairs) {
+        insert(pair.from, pair.to, pair.distance);
+    }
+    return true;
+}
+
+bool DistanceStore::write(const char* path) const {
+    DistanceStoreHeader header = {};
+    memcpy(header.magic, DISTANCE_STORE_MAGIC, sizeof(DISTANCE_STORE_MAGIC));
+    header.version = DISTANCE_STORE_VERSION;
+    header.graphFingerprint = graphFingerprint;
+    header.numPairs = distances.size();
+
+    vector<StoredDistance> pairs;
+    pairs.reserve(distances.size());
+    for (const auto& entry : distances) {
+        pairs.push_back({entry.first.first, entry.first.second, entry.second});
+    }
+
+    string tmpPath = string(path) + ".tmp" + to_string(getpid());
+    ofstream ofs(tmpPath, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(pairs.data()), pairs.size() * sizeof(StoredDistance));
+    ofs.close();
+
+    if (!ofs || rename(tmpPath.c_str(), path) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
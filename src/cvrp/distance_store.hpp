@@ -0,0 +1,48 @@
+#ifndef DISTANCE_STORE_H
+#define DISTANCE_STORE_H
+
+#include <unordered_map>
+#include <utility>
+#include "../types.hpp"
+#include "../utils.hpp"
+
+// Shortest path distances between pairs of OSM nodes of a road graph, kept
+// across runs so that instances of the same region, whose locations match
+// many of the same nodes from one day to the next, only search for the pairs
+// not seen before. A store belongs to the graph with the given fingerprint
+// (see Graph::fingerprint), taken before any contraction.
+class DistanceStore {
+    public:
+        explicit DistanceStore(u64 graphFingerprint) : graphFingerprint(graphFingerprint) {}
+
+        // Returns false if the file does not exist, has a different format
+        // version or belongs to another graph, in which case the store is left
+        // untouched
+        bool read(const char* path);
+
+        // Written under a temporary name and then renamed, so a concurrent run
+        // never reads half of it
+        bool write(const char* path) const;
+
+        // DBL_MAX when to is unreachable from from
+        bool find(u64 from, u64 to, double& distance) const {
+            auto it = distances.find({from, to});
+            if (it == distances.end()) return false;
+
+            distance = it->second;
+            return true;
+        }
+
+        void insert(u64 from, u64 to, double distance) {
+            distances[{from, to}] = distance;
+        }
+
+        size_t size() const {
+            return distances.size();
+        }
+    private:
+        u64 graphFingerprint;
+        std::unordered_map<std::pair<u64, u64>, double, PairHash> distances;
+};
+
+#endif // DISTANCE_STORE_H
@@ -0,0 +1,117 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "dm_cache.hpp"
+
+using namespace std;
+
+static const char DM_CACHE_MAGIC[8] = {'C', 'V', 'R', 'P', 'D', 'M', 'A', 'T'};
+static const u32 DM_CACHE_VERSION = 1;
+
+// File layout (native endianness): header, matched nodes (u64[n], origin
+// first), distances (double[n * n], row by row). The nodes are stored in full
+// so that a hash collision is not mistaken for a hit.
+struct DmCacheHeader {
+    char magic[8];
+    u32 version;
+    u32 reserved;
+    u64 graphFingerprint;
+    u64 numLocations;
+};
+
+static vector<u64> matchedNodes(const MapMatchingResult& mmResult) {
+    vector<u64> nodes = {mmResult.originNode};
+    nodes.insert(nodes.end(), mmResult.deliveryNodes.begin(), mmResult.deliveryNodes.end());
+    return nodes;
+}
+
+string distanceMatrixCachePath(const string& directory, u64 graphFingerprint,
+        const MapMatchingResult& mmResult) {
+    u64 hash = 14695981039346656037ULL;
+    auto addBytes = [&hash](const void* data, size_t size) {
+        const u8* bytes = static_cast<const u8*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+
+    vector<u64> nodes = matchedNodes(mmResult);
+    addBytes(&graphFingerprint, sizeof(u64));
+    addBytes(nodes.data(), nodes.size() * sizeof(u64));
+
+    ostringstream path;
+    path << directory << "/" << hex << setw(16) << setfill('0') << hash << ".dm";
+    return path.str();
+}
+
+bool readDistanceMatrixCache(const string& directory, u64 graphFingerprint,
+        const MapMatchingResult& mmResult, CvrpInstance& instance) {
+    string path = distanceMatrixCachePath(directory, graphFingerprint, mmResult);
+    ifstream ifs(path, ios::binary);
+    if (!ifs.good()) return false;
+
+    vector<u64> nodes = matchedNodes(mmResult);
+    u64 n = nodes.size();
+    if (n != instance.getDistanceMatrix().size()) return false;
+
+    DmCacheHeader header;
+    if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    if (memcmp(header.magic, DM_CACHE_MAGIC, sizeof(DM_CACHE_MAGIC)) != 0 ||
+            header.version != DM_CACHE_VERSION || header.graphFingerprint != graphFingerprint ||
+            header.numLocations != n) {
+        return false;
+    }
+
+    vector<u64> storedNodes(n);
+    vector<double> distances(n * n);
+    ifs.read(reinterpret_cast<char*>(storedNodes.data()), n * sizeof(u64));
+    ifs.read(reinterpret_cast<char*>(distances.data()), n * n * sizeof(double));
+
+    // Nothing may follow the matrix
+    if (!ifs || ifs.peek() != EOF || storedNodes != nodes) return false;
+
+    for (u64 from = 0; from < n; ++from) {
+        for (u64 to = 0; to < n; ++to) {
+            instance.setDistance(from, to, distances[from * n + to]);
+        }
+    }
+    return true;
+}
+
+bool writeDistanceMatrixCache(const string& directory, u64 graphFingerprint,
+        const MapMatchingResult& mmResult, const CvrpInstance& instance) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return false;
+
+    vector<u64> nodes = matchedNodes(mmResult);
+    const auto& matrix = instance.getDistanceMatrix();
+    if (matrix.size() != nodes.size()) return false;
+
+    DmCacheHeader header = {};
+    memcpy(header.magic, DM_CACHE_MAGIC, sizeof(DM_CACHE_MAGIC));
+    header.version = DM_CACHE_VERSION;
+    header.graphFingerprint = graphFingerprint;
+    header.numLocations = nodes.size();
+
+    string path = distanceMatrixCachePath(directory, graphFingerprint, mmResult);
+    string tmpPath = path + ".tmp" + to_string(getpid());
+
+    ofstream ofs(tmpPath, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(u64));
+    for (const auto& row : matrix) {
+        ofs.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(double));
+    }
+    ofs.close();
+
+    if (!ofs || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef DM_CACHE_H
+#define DM_CACHE_H
+
+#include <string>
+#include "cvrp.hpp"
+#include "stage_1.hpp"
+
+// Distance matrices are stored in a cache directory, each in a file named after
+// a hash of the road graph's fingerprint (see Graph::fingerprint) and of the
+// nodes the locations were matched to, so instances whose locations match the
+// same nodes, as the same addresses do on different days, share a matrix.
+// The fingerprint is that of the graph the matrix is computed on, taken after
+// any cropping and before contraction.
+std::string distanceMatrixCachePath(const std::string& directory, u64 graphFingerprint,
+    const MapMatchingResult& mmResult);
+
+// Fills the instance's distance matrix from the cache. Returns false if there
+// is no matrix for the graph and matched nodes, or if the file has a different
+// format version or does not match them, in which case the instance is left
+// untouched.
+bool readDistanceMatrixCache(const std::string& directory, u64 graphFingerprint,
+    const MapMatchingResult& mmResult, CvrpInstance& instance);
+
+// Creates the directory if needed. The file is written under a temporary name
+// and then renamed, so a concurrent run never reads half of it.
+bool writeDistanceMatrixCache(const std::string& directory, u64 graphFingerprint,
+    const MapMatchingResult& mmResult, const CvrpInstance& instance);
+
+#endif // DM_CACHE_H
@@ -1,12 +1,11 @@
 
+#include <algorithm>
 #include <chrono>
-#include <condition_variable>
 #include <fstream>
-#include <mutex>
-#include <queue>
-#include <thread>
+#include <unordered_set>
 #include "stage_1.hpp"
 #include "../algorithms/a_star.hpp"
+#include "../algorithms/delta_stepping.hpp"
 #include "../data_structures/quadtree.hpp"
 #include "../data_structures/kd_tree.hpp"
 #include "../utils.hpp"
@@ -35,9 +34,9 @@ MapMatchingResult matchLocations(const OsmXmlData& osmData,
 
     if (dataStructure == QUADTREE) {
         Quadtree tree(AABB(osmData.minCoords, osmData.maxCoords));
-        for (const pair<u64, const OsmNode&>& p : osmData.graph.getNodes()) {
-            if (p.second.mapMatch) {
-                tree.insert(p.second);
+        for (const OsmNode& node : osmData.graph.getNodes()) {
+            if (node.mapMatch) {
+                tree.insert(node);
             }
         }
 
@@ -68,9 +67,9 @@ MapMatchingResult matchLocations(const OsmXmlData& osmData,
         vector<reference_wrapper<const OsmNode>> v;
         v.reserve(osmData.graph.getNodes().size());
 
-        for (const pair<u64, const OsmNode&>& p : osmData.graph.getNodes()) {
-            if (p.second.mapMatch) {
-                v.push_back(p.second);
+        for (const OsmNode& node : osmData.graph.getNodes()) {
+            if (node.mapMatch) {
+                v.push_back(node);
             }
         }
 
@@ -110,26 +109,6 @@ MapMatchingResult matchLocations(const OsmXmlData& osmData,
     return {originNode, deliveryNodes};
 }
 
-struct DijkstraThreadData {
-    DijkstraThreadData(const OsmXmlData& osmData, CvrpInstance& problem,
-            const MapMatchingResult& mmResult, bool printLogs, ofstream& ofs) : osmData(osmData),
-            problem(problem), mmResult(mmResult), printLogs(printLogs),
-            aStdOut(cout), aOfs(ofs) {}
-
-    // Concurrency
-    bool terminated = false;
-    condition_variable cond;
-    mutex queueMutex;
-    queue<u64> jobQueue;
-    AtomicOStream aStdOut, aOfs;
-
-    // Data
-    const OsmXmlData& osmData;
-    CvrpInstance& problem;
-    const MapMatchingResult& mmResult;
-    bool printLogs;
-};
-
 size_t matchedPoint(const MapMatchingResult& mmResult, size_t idx) {
     if (idx == 0) {
         return mmResult.originNode;
@@ -137,96 +116,466 @@ size_t matchedPoint(const MapMatchingResult& mmResult, size_t idx) {
     return mmResult.deliveryNodes[idx - 1];
 }
 
-void dijkstraThreadJob(DijkstraThreadData* data, ShortestPathDataStructure dataStructure) {
-    u64 from;
-    size_t n = 1 + data->problem.getDeliveries().size();
+// Rows of the matrix in decreasing order of their expected cost. A search
+// runs until the farthest location is settled, so rows are ranked by the
+// straight-line distance from their location to the farthest one.
+static vector<size_t> rowsByExpectedCost(const Graph<OsmNode>& g,
+        const MapMatchingResult& mmResult, size_t n) {
+    vector<Coordinates> coords;
+    coords.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        coords.push_back(g.getNode(g.getIndex(matchedPoint(mmResult, i))).coordinates);
+    }
 
-    while (true) {
-        {
-            unique_lock<mutex> lock(data->queueMutex);
+    vector<double> spread(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            double d = coords[i].haversine(coords[j]);
+            spread[i] = max(spread[i], d);
+            spread[j] = max(spread[j], d);
+        }
+    }
 
-            data->cond.wait(lock, [data] {
-                return !data->jobQueue.empty() || data->terminated;
-            });
+    vector<size_t> rows(n);
+    for (size_t i = 0; i < n; ++i) {
+        rows[i] = i;
+    }
+    stable_sort(rows.begin(), rows.end(), [&](size_t a, size_t b) {
+        return spread[a] > spread[b];
+    });
+    return rows;
+}
 
-            if (data->jobQueue.empty()) {
-                // Pool terminated and no more jobs to run
-                return;
-            }
+// Rows per chunk of the work-stealing scheduler: several chunks per thread,
+// so that threads that finish early have something to steal
+static size_t rowChunkSize(size_t numRows, u32 numThreads) {
+    return max<size_t>(1, numRows / (8 * max(numThreads, 1u)));
+}
 
-            from = data->jobQueue.front();
-            data->jobQueue.pop();
-        }
+void calculateShortestPaths(const OsmXmlData& osmData, CvrpInstance& problem,
+        const MapMatchingResult& mmResult, ShortestPathDataStructure dataStructure,
+        bool printLogs, u32 numThreads, const string& filePath) {
+    ofstream ofs(filePath);
+    AtomicOStream aStdOut(cout), aOfs(ofs);
+
+    size_t n = 1 + problem.getDeliveries().size();
+    numThreads = max(numThreads, 1u);
 
-        vector<u64> endVec;
+    // Allocated once per worker and reused for every row
+    vector<SearchWorkspace> workspaces(numThreads);
+    vector<vector<u64>> endVecs(numThreads);
+    vector<vector<double>> rowDistances(numThreads);
+
+    // We can't assume d[from, to] == d[to, from] since there are directed edges
+    vector<size_t> rows = rowsByExpectedCost(osmData.graph, mmResult, n);
+    runWorkStealing(rows, numThreads, rowChunkSize(n, numThreads), [&](size_t from, u32 thread) {
+        vector<u64>& endVec = endVecs[thread];
+        endVec.clear();
         for (size_t to = 0; to < n; ++to) {
             if (from != to) {
-                endVec.push_back(matchedPoint(data->mmResult, to));
+                endVec.push_back(matchedPoint(mmResult, to));
             }
         }
 
+        // Only distances are needed, so no paths are built
+        vector<double>& distances = rowDistances[thread];
         auto start = high_resolution_clock::now();
-        vector<ShortestPathResult> resultVec = dijkstra(
-            data->osmData.graph,
-            matchedPoint(data->mmResult, from),
+        dijkstraDistances(
+            osmData.graph,
+            matchedPoint(mmResult, from),
             endVec,
-            dataStructure
+            dataStructure,
+            workspaces[thread],
+            distances
         );
         auto end = high_resolution_clock::now();
-        if (data->printLogs) {
+        if (printLogs) {
             auto us = interval<chrono::microseconds>(start, end);
-            data->aStdOut << "Finished Dijkstra for location " << from << " in " << us << "us." << "\n";
-            data->aStdOut.flush();
-            data->aOfs << us << " ";
+            aStdOut << "Finished Dijkstra for location " << from << " in " << us << "us." << "\n";
+            aStdOut.flush();
+            aOfs << us << " ";
         }
 
-        for (size_t idx = 0; idx < resultVec.size(); ++idx) {
+        // Locations without a path are left at DBL_MAX
+        for (size_t idx = 0; idx < distances.size(); ++idx) {
             size_t to = idx >= from ? idx + 1 : idx;
-            const auto& result = resultVec[idx];
+            problem.setDistance(from, to, distances[idx]);
+        }
+    });
 
-            if (result.path.size() == 0) {
-                // Couldn't find a path...
-                data->problem.setDistance(from, to, DBL_MAX);
+    ofs.close();
+}
+
+void calculateShortestPathsIncremental(const OsmXmlData& osmData, CvrpInstance& problem,
+        const MapMatchingResult& mmResult, DistanceStore& store,
+        ShortestPathDataStructure dataStructure, bool printLogs, u32 numThreads,
+        const string& filePath) {
+    ofstream ofs(filePath);
+    AtomicOStream aStdOut(cout), aOfs(ofs);
+
+    size_t n = 1 + problem.getDeliveries().size();
+    numThreads = max(numThreads, 1u);
+
+    // Locations matched to the same node share their searches, so pairs are
+    // counted between distinct nodes
+    vector<u64> nodes;
+    for (size_t i = 0; i < n; ++i) {
+        nodes.push_back(matchedPoint(mmResult, i));
+    }
+    sort(nodes.begin(), nodes.end());
+    nodes.erase(unique(nodes.begin(), nodes.end()), nodes.end());
+
+    // Nodes still needed from each location's node, kept by the first
+    // location matched to it
+    vector<vector<u64>> missing(n);
+    unordered_set<u64> sources;
+    size_t numPairs = 0, numHits = 0;
+    for (size_t from = 0; from < n; ++from) {
+        u64 fromNode = matchedPoint(mmResult, from);
+        if (!sources.insert(fromNode).second) continue;
+
+        for (u64 toNode : nodes) {
+            if (toNode == fromNode) continue;
+
+            double distance;
+            ++numPairs;
+            if (store.find(fromNode, toNode, distance)) {
+                ++numHits;
             }
             else {
-                data->problem.setDistance(from, to, result.distance);
+                missing[from].push_back(toNode);
+            }
+        }
+    }
+
+    vector<size_t> rows;
+    for (size_t from : rowsByExpectedCost(osmData.graph, mmResult, n)) {
+        if (!missing[from].empty()) rows.push_back(from);
+    }
+
+    // Only distances are needed, so no paths are built
+    vector<SearchWorkspace> workspaces(numThreads);
+    vector<vector<double>> found(n);
+    runWorkStealing(rows, numThreads, rowChunkSize(rows.size(), numThreads),
+            [&](size_t from, u32 thread) {
+        auto start = high_resolution_clock::now();
+        dijkstraDistances(osmData.graph, matchedPoint(mmResult, from), missing[from],
+            dataStructure, workspaces[thread], found[from]);
+        auto end = high_resolution_clock::now();
+
+        if (printLogs) {
+            auto us = interval<microseconds>(start, end);
+            aStdOut << "Finished Dijkstra for location " << from << " (" << missing[from].size()
+                << " missing) in " << us << "us." << "\n";
+            aStdOut.flush();
+            aOfs << us << " ";
+        }
+    });
+
+    for (size_t from : rows) {
+        u64 fromNode = matchedPoint(mmResult, from);
+        for (size_t i = 0; i < missing[from].size(); ++i) {
+            store.insert(fromNode, missing[from][i], found[from][i]);
+        }
+    }
+
+    // Locations without a path are left at DBL_MAX, and those matched to the
+    // same node at 0
+    for (size_t from = 0; from < n; ++from) {
+        u64 fromNode = matchedPoint(mmResult, from);
+        for (size_t to = 0; to < n; ++to) {
+            double distance;
+            if (store.find(fromNode, matchedPoint(mmResult, to), distance)) {
+                problem.setDistance(from, to, distance);
             }
         }
     }
+
+    if (printLogs) {
+        cout << "Distance store had " << numHits << " of " << numPairs << " pairs ("
+            << (numPairs == 0 ? 100.0 : 100.0 * numHits / numPairs) << "% hit rate), searched from "
+            << rows.size() << " of " << sources.size() << " nodes\n";
+    }
+    ofs.close();
 }
 
-void calculateShortestPaths(const OsmXmlData& osmData, CvrpInstance& problem,
-        const MapMatchingResult& mmResult, ShortestPathDataStructure dataStructure,
-        bool printLogs, u32 numThreads, const string& filePath) {
+void calculateShortestPathsBatched(const OsmXmlData& osmData, CvrpInstance& problem,
+        const MapMatchingResult& mmResult, bool printLogs, u32 numThreads,
+        const string& filePath) {
+    static const u32 LANES = BatchWorkspace::LANES;
+
     ofstream ofs(filePath);
+    AtomicOStream aStdOut(cout), aOfs(ofs);
+    const Graph<OsmNode>& g = osmData.graph;
+
+    size_t n = 1 + problem.getDeliveries().size();
+    numThreads = max(numThreads, 1u);
 
-    // Multithreading support
-    DijkstraThreadData threadData(osmData, problem, mmResult, printLogs, ofs);
+    vector<u64> endVec(n);
+    for (size_t i = 0; i < n; ++i) {
+        endVec[i] = matchedPoint(mmResult, i);
+    }
 
-    vector<thread> threads;
-    threads.reserve(numThreads);
-    for (u32 _ = 0; _ < numThreads; ++_) {
-        threads.push_back(thread(dijkstraThreadJob, &threadData, dataStructure));
+    // The searches of a group only share work where their wavefronts meet, so
+    // each location is grouped with the closest ones not grouped yet
+    vector<Coordinates> coords;
+    coords.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        coords.push_back(g.getNode(g.getIndex(endVec[i])).coordinates);
     }
 
+    vector<size_t> locations;
+    locations.reserve(n);
+    vector<bool> grouped(n, false);
+    for (size_t i = 0; i < n; ++i) {
+        if (grouped[i]) continue;
+        grouped[i] = true;
+        locations.push_back(i);
+
+        for (u32 lane = 1; lane < LANES; ++lane) {
+            size_t closest = n;
+            double closestDistance = DBL_MAX;
+            for (size_t j = 0; j < n; ++j) {
+                if (grouped[j]) continue;
+                double distance = coords[i].haversine(coords[j]);
+                if (distance < closestDistance) {
+                    closest = j;
+                    closestDistance = distance;
+                }
+            }
+            if (closest == n) break;
+
+            grouped[closest] = true;
+            locations.push_back(closest);
+        }
+    }
+
+    size_t numGroups = (n + LANES - 1) / LANES;
+
+    vector<BatchWorkspace> workspaces(numThreads);
+    vector<vector<vector<double>>> rows(numThreads);
+
+    auto start = high_resolution_clock::now();
+    runWorkStealing(numGroups, numThreads, 1, [&](size_t group, u32 thread) {
+        size_t first = group * LANES;
+        u32 numSources = min<size_t>(LANES, n - first);
+
+        u64 sources[LANES];
+        for (u32 lane = 0; lane < numSources; ++lane) {
+            sources[lane] = endVec[locations[first + lane]];
+        }
+
+        auto start = high_resolution_clock::now();
+        batchedDijkstraDistances(g, sources, numSources, endVec, workspaces[thread], rows[thread]);
+        auto end = high_resolution_clock::now();
+
+        for (u32 lane = 0; lane < numSources; ++lane) {
+            size_t from = locations[first + lane];
+            for (size_t to = 0; to < n; ++to) {
+                if (from != to) {
+                    problem.setDistance(from, to, rows[thread][lane][to]);
+                }
+            }
+        }
+
+        if (printLogs) {
+            auto us = interval<microseconds>(start, end);
+            aStdOut << "Finished batched Dijkstra for " << numSources << " locations in "
+                << us << "us." << "\n";
+            aStdOut.flush();
+            aOfs << us << " ";
+        }
+    });
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        u64 us = max<u64>(interval<microseconds>(start, end), 1);
+        cout << "Computed " << n << " rows in " << us / 1000 << "ms ("
+            << (u64) (n * 1e6 / us) << " rows/s)\n";
+    }
+
+    ofs.close();
+}
+
+void calculateShortestPathsDeltaStepping(const OsmXmlData& osmData, CvrpInstance& problem,
+        const MapMatchingResult& mmResult, bool printLogs, u32 numThreads, double delta,
+        const string& filePath) {
+    ofstream ofs(filePath);
+    DeltaStepping search(osmData.graph, numThreads, delta);
+
     size_t n = 1 + problem.getDeliveries().size();
+    vector<u64> endVec(n);
+    for (size_t i = 0; i < n; ++i) {
+        endVec[i] = matchedPoint(mmResult, i);
+    }
 
-    // We can't assume d[from, to] == d[to, from] since there are directed edges
+    vector<double> row;
     for (size_t from = 0; from < n; ++from) {
-        {
-            unique_lock<mutex> lock(threadData.queueMutex);
-            threadData.jobQueue.push(from);
+        auto start = high_resolution_clock::now();
+        search.distances(endVec[from], endVec, row);
+        auto end = high_resolution_clock::now();
+
+        for (size_t to = 0; to < n; ++to) {
+            if (from != to) {
+                problem.setDistance(from, to, row[to]);
+            }
         }
-        threadData.cond.notify_one();
-    } 
 
-    // Shutdown thread pool and join all threads
-    threadData.terminated = true;
-    threadData.cond.notify_all();
-    for (thread& t : threads) {
-        t.join();
+        if (printLogs) {
+            auto us = interval<microseconds>(start, end);
+            cout << "Finished delta-stepping for location " << from << " in " << us << "us ("
+                << search.numRounds() << " rounds)." << "\n";
+            ofs << us << " ";
+        }
     }
-    threads.clear();
 
+    if (printLogs) {
+        cout << "Delta-stepping used buckets of " << search.getDelta() << "\n";
+    }
     ofs.close();
-}
\ No newline at end of file
+}
+
+void calculateShortestPathsHierarchy(const OsmXmlData& osmData, const ContractionHierarchy& ch,
+        CvrpInstance& problem, const MapMatchingResult& mmResult, bool printLogs,
+        u32 numThreads, const string& filePath) {
+    ofstream ofs(filePath);
+    AtomicOStream aStdOut(cout), aOfs(ofs);
+
+    size_t n = 1 + problem.getDeliveries().size();
+    numThreads = max(numThreads, 1u);
+    vector<u32> indices(n);
+    for (size_t i = 0; i < n; ++i) {
+        indices[i] = osmData.graph.getIndex(matchedPoint(mmResult, i));
+    }
+
+    // Each thread reuses its query state for every row
+    vector<ContractionHierarchyQuery> queries;
+    queries.reserve(numThreads);
+    for (u32 t = 0; t < numThreads; ++t) {
+        queries.emplace_back(ch);
+    }
+
+    runWorkStealing(n, numThreads, rowChunkSize(n, numThreads), [&](size_t from, u32 thread) {
+        auto start = high_resolution_clock::now();
+        for (size_t to = 0; to < n; ++to) {
+            if (from != to) {
+                problem.setDistance(from, to, queries[thread].distance(indices[from], indices[to]));
+            }
+        }
+        auto end = high_resolution_clock::now();
+
+        if (printLogs) {
+            auto us = interval<microseconds>(start, end);
+            aStdOut << "Finished hierarchy queries for location " << from << " in " << us << "us." << "\n";
+            aStdOut.flush();
+            aOfs << us << " ";
+        }
+    });
+
+    ofs.close();
+}
+
+void calculateShortestPathsBuckets(const OsmXmlData& osmData, const ContractionHierarchy& ch,
+        CvrpInstance& problem, const MapMatchingResult& mmResult, bool printLogs,
+        u32 numThreads, const string& filePath) {
+    ofstream ofs(filePath);
+    AtomicOStream aStdOut(cout), aOfs(ofs);
+
+    size_t n = 1 + problem.getDeliveries().size();
+    numThreads = max(numThreads, 1u);
+    vector<u32> indices(n);
+    for (size_t i = 0; i < n; ++i) {
+        indices[i] = osmData.graph.getIndex(matchedPoint(mmResult, i));
+    }
+
+    auto start = high_resolution_clock::now();
+    ContractionHierarchyBuckets buckets(ch, indices, numThreads);
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Filled " << buckets.numEntries() << " bucket entries in "
+            << interval<microseconds>(start, end) << "us\n";
+    }
+
+    vector<ContractionHierarchyQuery> queries;
+    queries.reserve(numThreads);
+    for (u32 t = 0; t < numThreads; ++t) {
+        queries.emplace_back(ch);
+    }
+    vector<vector<double>> rows(numThreads);
+
+    runWorkStealing(n, numThreads, rowChunkSize(n, numThreads), [&](size_t from, u32 thread) {
+        vector<double>& row = rows[thread];
+        auto start = high_resolution_clock::now();
+        buckets.distances(queries[thread], indices[from], row);
+        for (size_t to = 0; to < n; ++to) {
+            if (from != to) {
+                problem.setDistance(from, to, row[to]);
+            }
+        }
+        auto end = high_resolution_clock::now();
+
+        if (printLogs) {
+            auto us = interval<microseconds>(start, end);
+            aStdOut << "Finished bucket scan for location " << from << " in " << us << "us." << "\n";
+            aStdOut.flush();
+            aOfs << us << " ";
+        }
+    });
+
+    ofs.close();
+}
+
+void calculateShortestPathsPhast(const OsmXmlData& osmData, const ContractionHierarchy& ch,
+        CvrpInstance& problem, const MapMatchingResult& mmResult, bool printLogs,
+        u32 numThreads, const string& filePath) {
+    ofstream ofs(filePath);
+    AtomicOStream aStdOut(cout), aOfs(ofs);
+
+    size_t n = 1 + problem.getDeliveries().size();
+    numThreads = max(numThreads, 1u);
+    vector<u32> indices(n);
+    for (size_t i = 0; i < n; ++i) {
+        indices[i] = osmData.graph.getIndex(matchedPoint(mmResult, i));
+    }
+
+    PhastSweep sweep(ch);
+
+    vector<ContractionHierarchyQuery> queries;
+    queries.reserve(numThreads);
+    for (u32 t = 0; t < numThreads; ++t) {
+        queries.emplace_back(ch);
+    }
+    vector<vector<vector<double>>> rows(numThreads);
+    vector<vector<double>> lanes(numThreads);
+
+    // Each job is a group of rows, one row per lane
+    size_t numGroups = (n + PhastSweep::LANES - 1) / PhastSweep::LANES;
+    runWorkStealing(numGroups, numThreads, 1, [&](size_t group, u32 thread) {
+        size_t first = group * PhastSweep::LANES;
+        u32 numSources = min<size_t>(PhastSweep::LANES, n - first);
+
+        auto start = high_resolution_clock::now();
+        sweep.distances(queries[thread], indices.data() + first, numSources, indices,
+            rows[thread], lanes[thread]);
+        for (u32 lane = 0; lane < numSources; ++lane) {
+            size_t from = first + lane;
+            for (size_t to = 0; to < n; ++to) {
+                if (from != to) {
+                    problem.setDistance(from, to, rows[thread][lane][to]);
+                }
+            }
+        }
+        auto end = high_resolution_clock::now();
+
+        if (printLogs) {
+            auto us = interval<microseconds>(start, end);
+            aStdOut << "Finished sweep for locations " << first << "-" << first + numSources - 1
+                << " in " << us << "us." << "\n";
+            aStdOut.flush();
+            aOfs << us << " ";
+        }
+    });
+
+    ofs.close();
+}
@@ -4,8 +4,10 @@
 
 #include <unordered_map>
 #include "../types.hpp"
+#include "../algorithms/contraction_hierarchy.hpp"
 #include "../osm/osm.hpp"
 #include "cvrp.hpp"
+#include "distance_store.hpp"
 
 enum MapMatchingDataStructure {
     QUADTREE,
@@ -20,6 +22,23 @@ struct MapMatchingResult {
 enum ShortestPathDataStructure {
     FIBONACCI_HEAP,
     BINARY_HEAP,
+    RADIX_HEAP,
+    DIAL_BUCKETS,
+    QUATERNARY_HEAP,
+    OCTONARY_HEAP,
+};
+
+// How the distance matrix is computed: one Dijkstra search per location (or
+// for a few locations at once), one delta-stepping search per location using
+// every thread, one hierarchy query per pair of locations, hierarchy searches
+// sharing buckets, or a sweep over the whole hierarchy for every few locations
+enum MatrixEngine {
+    DIJKSTRA_SEARCHES,
+    BATCHED_SEARCHES,
+    DELTA_STEPPING_SEARCHES,
+    CH_QUERIES,
+    CH_BUCKETS,
+    PHAST_SWEEPS,
 };
 
 // Maps LoggiBUD location IDs to the IDs of nodes in the OSM network
@@ -31,4 +50,44 @@ void calculateShortestPaths(const OsmXmlData& osmData, CvrpInstance& problem,
     const MapMatchingResult& mmResult, ShortestPathDataStructure dataStructure = FIBONACCI_HEAP,
     bool printLogs = false, u32 numThreads = 1, const std::string& filePath = "shortest_paths.txt");
 
+// Same as calculateShortestPaths, taking the distances between matched nodes
+// from the store when it has them. Only rows with pairs missing from the store
+// are searched, and only until the missing locations are settled; their
+// distances are then added to the store.
+void calculateShortestPathsIncremental(const OsmXmlData& osmData, CvrpInstance& problem,
+    const MapMatchingResult& mmResult, DistanceStore& store,
+    ShortestPathDataStructure dataStructure = FIBONACCI_HEAP, bool printLogs = false,
+    u32 numThreads = 1, const std::string& filePath = "shortest_paths.txt");
+
+// Same as calculateShortestPaths, computing BatchWorkspace::LANES rows of the
+// matrix with each search, for locations that are close to each other
+void calculateShortestPathsBatched(const OsmXmlData& osmData, CvrpInstance& problem,
+    const MapMatchingResult& mmResult, bool printLogs = false, u32 numThreads = 1,
+    const std::string& filePath = "shortest_paths.txt");
+
+// Same as calculateShortestPaths, with the threads sharing each search (see
+// DeltaStepping) instead of taking a row each, for when there are fewer
+// locations than threads. A delta of 0 picks one from the graph.
+void calculateShortestPathsDeltaStepping(const OsmXmlData& osmData, CvrpInstance& problem,
+    const MapMatchingResult& mmResult, bool printLogs = false, u32 numThreads = 1,
+    double delta = 0, const std::string& filePath = "shortest_paths.txt");
+
+// Same as calculateShortestPaths, answering each pair of locations with a query
+// on a contraction hierarchy of the road graph
+void calculateShortestPathsHierarchy(const OsmXmlData& osmData, const ContractionHierarchy& ch,
+    CvrpInstance& problem, const MapMatchingResult& mmResult, bool printLogs = false,
+    u32 numThreads = 1, const std::string& filePath = "shortest_paths.txt");
+
+// Same as calculateShortestPaths, using the many-to-many bucket algorithm on a
+// contraction hierarchy of the road graph
+void calculateShortestPathsBuckets(const OsmXmlData& osmData, const ContractionHierarchy& ch,
+    CvrpInstance& problem, const MapMatchingResult& mmResult, bool printLogs = false,
+    u32 numThreads = 1, const std::string& filePath = "shortest_paths.txt");
+
+// Same as calculateShortestPaths, computing PhastSweep::LANES rows of the
+// matrix with each sweep over a contraction hierarchy of the road graph
+void calculateShortestPathsPhast(const OsmXmlData& osmData, const ContractionHierarchy& ch,
+    CvrpInstance& problem, const MapMatchingResult& mmResult, bool printLogs = false,
+    u32 numThreads = 1, const std::string& filePath = "shortest_paths.txt");
+
 #endif // CVRP_STAGE_1_H
@@ -1,6 +1,7 @@
 
 #include "visualization.hpp"
 #include "../algorithms/a_star.hpp"
+#include "../osm/preprocessing.hpp"
 #include <unordered_map>
 #include <algorithm>
 #include <random>
@@ -19,28 +20,59 @@ GraphVisualizationResult* generateGraphVisualization(const OsmXmlData& data, flo
     // TODO: make this a parameter?
     result.gv->setScale(5);
 
-    for (const auto& p : data.graph.getNodes()) {
-        auto& node = result.gv->addNode(p.first, vecFromCoordinates(p.second.coordinates, scale));
+    const Graph<OsmNode>& graph = data.graph;
+
+    auto addNode = [&](const OsmNode& osmNode) {
+        if (result.edgeIds.count(osmNode.id)) return;
+
+        auto& node = result.gv->addNode(osmNode.id, vecFromCoordinates(osmNode.coordinates, scale));
         node.disable();
-        result.edgeIds[p.first] = {};
+        result.edgeIds[osmNode.id] = {};
+    };
+
+    for (const OsmNode& osmNode : graph.getNodes()) {
+        addNode(osmNode);
+    }
+    for (const auto& p : data.edgeGeometry) {
+        for (const OsmNode& osmNode : p.second) {
+            addNode(osmNode);
+        }
     }
 
     u64 eId = 0;
-    for (const auto& nodeP : data.graph.getNodes()) {
-        for (const auto& edgeP : data.graph.getEdges(nodeP.first)) {
-            if (result.edgeIds.count(edgeP.first)) {
-                if (result.edgeIds.at(edgeP.first).count(nodeP.first)) {
-                    // Edge is bidirectional, this prevents drawing it twice
-                    result.edgeIds[nodeP.first][edgeP.first] = result.edgeIds[edgeP.first][nodeP.first];
-                    continue;
+    auto addEdge = [&](u64 from, u64 to) {
+        if (result.edgeIds.at(to).count(from)) {
+            // Edge is bidirectional, this prevents drawing it twice
+            result.edgeIds[from][to] = result.edgeIds[to][from];
+            return;
+        }
+
+        auto& edge = result.gv->addEdge(eId, result.gv->getNode(from),
+            result.gv->getNode(to));
+        edge.setThickness(8);
+        result.edgeIds[from][to] = eId;
+        ++eId;
+    };
+
+    for (u32 i = 0; i < graph.numNodes(); ++i) {
+        u64 from = graph.getId(i);
+
+        for (u32 e = graph.edgesBegin(i); e != graph.edgesEnd(i); ++e) {
+            u64 to = graph.getId(graph.getTarget(e));
+
+            // Contracted edges are drawn through the nodes they replaced
+            auto geometry = data.edgeGeometry.find(make_pair(from, to));
+            if (geometry != data.edgeGeometry.end()) {
+                u64 prev = from;
+                for (const OsmNode& osmNode : geometry->second) {
+                    addEdge(prev, osmNode.id);
+                    prev = osmNode.id;
                 }
+                addEdge(prev, to);
+            }
+            else {
+                addEdge(from, to);
             }
-
-            auto& edge = result.gv->addEdge(eId, result.gv->getNode(nodeP.first),
-                result.gv->getNode(edgeP.first));
-            edge.setThickness(8);
-            result.edgeIds[nodeP.first][edgeP.first] = eId;
-            ++eId;
         }
     }
 
@@ -110,7 +142,8 @@ void highlightPath(GraphVisualizationResult& result, const list<u64>& path, cons
 
 static const u32 MAX_RGB = 510;
 
-void showSolution(GraphVisualizationResult& result, const MapMatchingResult& mmResult, const Graph<OsmNode>& graph, const CvrpSolution& solution) {
+void showSolution(GraphVisualizationResult& result, const MapMatchingResult& mmResult, const OsmXmlData& data, const CvrpSolution& solution,
+        const Landmarks* landmarks) {
     auto matchedNode = [&mmResult](u64 idx) {
         return idx == 0 ? mmResult.originNode : mmResult.deliveryNodes[idx - 1];
     };
@@ -137,7 +170,9 @@ void showSolution(GraphVisualizationResult& result, const MapMatchingResult& mmR
 
         for (int i = 0; i < route.size() - 1; ++i) {
             u64 from = matchedNode(route[i]), to = matchedNode(route[i + 1]);
-            list<u64> path = aStarSearch(graph, from, to).first;
+            auto leg = landmarks ? aStarSearch(data.graph, from, to, *landmarks) :
+                aStarSearch(data.graph, from, to, costPerMeterBound(data));
+            list<u64> path = unpackPath(data, leg.first);
             highlightPath(result, path, color);
 
             if (route[i + 1] != 0) {
@@ -6,6 +6,7 @@
 #include <GraphViewerCpp/include/graphviewer.h>
 #include "../osm/osm.hpp"
 #include "../graph.hpp"
+#include "../algorithms/landmarks.hpp"
 #include "cvrp.hpp"
 #include "stage_1.hpp"
 
@@ -31,6 +32,8 @@ void setGraphCenter(GraphViewer& gv, const Coordinates& coords, float scale = 20
 void showMapMatchingResults(GraphViewer& gv, const CvrpInstance& instance,
     const MapMatchingResult& result, float scale = 200000.0);
 void highlightPath(GraphVisualizationResult& result, const std::list<u64>& path, const sf::Color& color = sf::Color::Red);
-void showSolution(GraphVisualizationResult& result, const MapMatchingResult& mmResult, const Graph<OsmNode>& graph, const CvrpSolution& solution);
+// Route legs are found with A*, guided by landmarks if given
+void showSolution(GraphVisualizationResult& result, const MapMatchingResult& mmResult, const OsmXmlData& data, const CvrpSolution& solution,
+    const Landmarks* landmarks = nullptr);
 
 #endif // VISUALIZATION_H
@@ -4,7 +4,7 @@
 
 #include <vector>
 #include <optional>
-#include <unordered_map>
+#include <cstdint>
 #include "../types.hpp"
 
 template <typename T>
@@ -29,15 +29,15 @@ class BinaryHeap {
             ++nextId;
 
             vec.push_back({id, data, key});
-            indices[id] = index;
+            indices.push_back(index);
 
             heapifyUp(index);
             return id;
         }
 
         T extractMin() {
-            BHNode<T>& min = vec.front();
-            T root = min.data;
+            u64 minId = vec.front().id;
+            T root = vec.front().data;
 
             if (vec.size() != 1) {
                 swap(0, vec.size() - 1);
@@ -47,13 +47,13 @@ class BinaryHeap {
             else {
                 vec.pop_back();
             }
-            indices.erase(min.id);
+            indices[minId] = REMOVED;
 
             return root;
         }
 
         void decreaseKey(u64 id, double key) {
-            if (indices.count(id)) {
+            if (indices[id] != REMOVED) {
                 BHNode<T>& node = vec[indices[id]];
                 if (key < node.key) {
                     node.key = key;
@@ -66,6 +66,13 @@ class BinaryHeap {
             return vec.empty();
         }
 
+        // Removes every element. Ids are handed out from 0 again.
+        void clear() {
+            vec.clear();
+            indices.clear();
+            nextId = 0;
+        }
+
         friend std::ostream& operator<<(std::ostream& os, const BinaryHeap<T>& obj) {
             for (const BHNode<T>& n : obj.vec) {
                 os << n.data << "[" << n.key << "]" << " ";
@@ -120,9 +127,13 @@ class BinaryHeap {
             return 2 * index + 2;
         }
 
+        static constexpr size_t REMOVED = SIZE_MAX;
+
+        // Ids are consecutive, so the position of each element is kept in a
+        // vector indexed by id
         u64 nextId = 0;
         std::vector<BHNode<T>> vec;
-        std::unordered_map<u64, size_t> indices;
+        std::vector<size_t> indices;
 };
 
 #endif // BINARY_HEAP_H
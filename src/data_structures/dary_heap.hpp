@@ -0,0 +1,89 @@
+#ifndef DARY_HEAP_H
+#define DARY_HEAP_H
+
+#include <vector>
+#include <cstdint>
+#include "../types.hpp"
+
+// Implicit heap where every node has D children, stored in a single vector.
+// There is no decrease-key, so nothing tracks where elements are: callers
+// insert the element again with its new key and skip the old entry when it
+// is extracted. A wider node makes the heap shallower and its children share
+// cache lines, which pays off since extractions dominate Dijkstra's searches.
+template <typename T, size_t D>
+class DaryHeap {
+    static_assert(D >= 2, "A d-ary heap needs at least 2 children per node");
+
+    public:
+        struct Entry {
+            double key;
+            T data;
+        };
+
+        explicit DaryHeap(size_t reserveSize = 0) {
+            vec.reserve(reserveSize);
+        }
+
+        void insert(T data, double key) {
+            vec.push_back({key, data});
+            heapifyUp(vec.size() - 1);
+        }
+
+        Entry extractMin() {
+            Entry root = vec.front();
+            Entry last = vec.back();
+            vec.pop_back();
+            if (!vec.empty()) heapifyDown(last);
+            return root;
+        }
+
+        bool empty() const {
+            return vec.empty();
+        }
+
+        size_t size() const {
+            return vec.size();
+        }
+
+        void clear() {
+            vec.clear();
+        }
+    private:
+        // Both sifts move a hole instead of swapping, so each level costs a
+        // single write
+        void heapifyUp(size_t index) {
+            Entry entry = vec[index];
+            while (index > 0) {
+                size_t p = (index - 1) / D;
+                if (!(entry.key < vec[p].key)) break;
+                vec[index] = vec[p];
+                index = p;
+            }
+            vec[index] = entry;
+        }
+
+        // Places entry in the hole left at the root
+        void heapifyDown(const Entry& entry) {
+            size_t index = 0, size = vec.size();
+
+            while (true) {
+                size_t first = D * index + 1;
+                if (first >= size) break;
+
+                size_t last = first + D < size ? first + D : size;
+                size_t min = first;
+                for (size_t c = first + 1; c < last; ++c) {
+                    if (vec[c].key < vec[min].key) min = c;
+                }
+
+                if (!(vec[min].key < entry.key)) break;
+                vec[index] = vec[min];
+                index = min;
+            }
+            vec[index] = entry;
+        }
+
+        std::vector<Entry> vec;
+};
+
+#endif // DARY_HEAP_H
@@ -0,0 +1,143 @@
+#ifndef DIAL_QUEUE_H
+#define DIAL_QUEUE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../types.hpp"
+
+// Monotone bucket queue (Dial's algorithm). Keys are quantized to integers by
+// dividing them by the bucket width, and buckets form a circular array that
+// covers the range of keys present in the queue, growing when a key falls
+// outside of it. The minimum is found by scanning the current bucket, so keys
+// are extracted in exact order; with a width close to the typical edge weight
+// buckets stay small.
+//
+// Elements are identified by consecutive ids, as in BinaryHeap. Decreasing a
+// key adds a new entry; entries whose key is no longer the element's key are
+// skipped when they are reached.
+template <typename T>
+class DialQueue {
+    public:
+        explicit DialQueue(double width = 1, size_t numBuckets = 1024) : width(width),
+            buckets(numBuckets) {}
+
+        u64 insert(T data, double key) {
+            u64 id = elements.size();
+            elements.push_back({data, key, false});
+            push(id, key);
+            ++size;
+            return id;
+        }
+
+        T extractMin() {
+            while (true) {
+                std::vector<Entry>& bucket = buckets[current % buckets.size()];
+
+                // Drop stale entries and find the minimum of the current bucket
+                size_t min = SIZE_MAX;
+                for (size_t i = 0; i < bucket.size();) {
+                    if (isStale(bucket[i])) {
+                        bucket[i] = bucket.back();
+                        bucket.pop_back();
+                        continue;
+                    }
+                    if (min == SIZE_MAX || bucket[i].key < bucket[min].key) min = i;
+                    ++i;
+                }
+
+                if (min == SIZE_MAX) {
+                    ++current;
+                    continue;
+                }
+
+                Element& element = elements[bucket[min].id];
+                bucket[min] = bucket.back();
+                bucket.pop_back();
+
+                element.removed = true;
+                --size;
+                return element.data;
+            }
+        }
+
+        void decreaseKey(u64 id, double key) {
+            Element& element = elements[id];
+            if (!element.removed && key < element.key) {
+                element.key = key;
+                push(id, key);
+            }
+        }
+
+        bool empty() const {
+            return size == 0;
+        }
+
+        // Removes every element. Ids are handed out from 0 again.
+        void clear() {
+            for (auto& bucket : buckets) {
+                bucket.clear();
+            }
+            elements.clear();
+            size = 0;
+            current = 0;
+            highest = 0;
+        }
+    private:
+        struct Entry {
+            u64 id;
+            double key;
+        };
+
+        struct Element {
+            T data;
+            double key;
+            bool removed;
+        };
+
+        double width;
+        std::vector<std::vector<Entry>> buckets;
+        std::vector<Element> elements;
+        size_t size = 0;
+
+        // Quantized keys of the bucket being extracted and of the highest
+        // entry inserted
+        u64 current = 0, highest = 0;
+
+        u64 quantize(double key) const {
+            return (u64) std::floor(key / width);
+        }
+
+        bool isStale(const Entry& entry) const {
+            const Element& element = elements[entry.id];
+            return element.removed || element.key != entry.key;
+        }
+
+        void push(u64 id, double key) {
+            u64 q = quantize(key);
+            if (q < current) q = current;
+            if (q > highest) highest = q;
+
+            // Keys from current to highest must map to different buckets
+            if (highest - current >= buckets.size()) grow();
+            buckets[q % buckets.size()].push_back({id, key});
+        }
+
+        void grow() {
+            size_t numBuckets = buckets.size();
+            while (highest - current >= numBuckets) numBuckets *= 2;
+
+            std::vector<std::vector<Entry>> old(numBuckets);
+            old.swap(buckets);
+            for (auto& bucket : old) {
+                for (const Entry& entry : bucket) {
+                    if (isStale(entry)) continue;
+                    u64 q = std::max(quantize(entry.key), current);
+                    buckets[q % buckets.size()].push_back(entry);
+                }
+            }
+        }
+};
+
+#endif // DIAL_QUEUE_H
@@ -37,6 +37,18 @@ class FibonacciHeap {
             return size;
         }
 
+        double getMinKey() const {
+            return min->key;
+        }
+
+        void clear() {
+            if (min) {
+                deleteAll(min);
+            }
+            min = nullptr;
+            size = 0;
+        }
+
         FHNode<T>* insert(T data, double key) {
             FHNode<T>* n = new FHNode<T>(data, key);
             n->next = n;
@@ -0,0 +1,133 @@
+#ifndef RADIX_HEAP_H
+#define RADIX_HEAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "../types.hpp"
+
+// Monotone priority queue for non-negative double keys: a key may not be
+// smaller than the last extracted one, which holds for Dijkstra's algorithm.
+// The bit patterns of non-negative doubles are ordered like the doubles, so
+// entries are bucketed by the highest bit in which their key differs from
+// the last extracted key, and each entry moves to a lower bucket at most 64
+// times.
+//
+// Elements are identified by consecutive ids, as in BinaryHeap. Decreasing a
+// key adds a new entry; entries whose key is no longer the element's key are
+// skipped when they are reached.
+template <typename T>
+class RadixHeap {
+    public:
+        RadixHeap() : buckets(65) {}
+
+        u64 insert(T data, double key) {
+            u64 id = elements.size();
+            elements.push_back({data, key, false});
+            push(id, key);
+            ++size;
+            return id;
+        }
+
+        T extractMin() {
+            Entry entry;
+            do {
+                if (buckets[0].empty()) refill();
+                entry = buckets[0].back();
+                buckets[0].pop_back();
+            } while (isStale(entry));
+
+            Element& element = elements[entry.id];
+            element.removed = true;
+            --size;
+            return element.data;
+        }
+
+        void decreaseKey(u64 id, double key) {
+            Element& element = elements[id];
+            if (!element.removed && key < element.key) {
+                element.key = key;
+                push(id, key);
+            }
+        }
+
+        bool empty() const {
+            return size == 0;
+        }
+
+        // Removes every element. Ids are handed out from 0 again.
+        void clear() {
+            for (auto& bucket : buckets) {
+                bucket.clear();
+            }
+            elements.clear();
+            size = 0;
+            last = 0;
+        }
+    private:
+        struct Entry {
+            u64 id;
+            u64 bits;
+        };
+
+        struct Element {
+            T data;
+            double key;
+            bool removed;
+        };
+
+        std::vector<std::vector<Entry>> buckets;
+        std::vector<Element> elements;
+        size_t size = 0;
+        u64 last = 0;
+
+        static u64 toBits(double key) {
+            u64 bits;
+            std::memcpy(&bits, &key, sizeof(bits));
+            return bits;
+        }
+
+        static u32 bucketOf(u64 bits, u64 last) {
+            return bits == last ? 0 : 64 - __builtin_clzll(bits ^ last);
+        }
+
+        void push(u64 id, double key) {
+            u64 bits = toBits(key);
+            buckets[bucketOf(bits, last)].push_back({id, bits});
+        }
+
+        bool isStale(const Entry& entry) const {
+            const Element& element = elements[entry.id];
+            return element.removed || toBits(element.key) != entry.bits;
+        }
+
+        // Moves the entries of the first non-empty bucket into lower buckets,
+        // relative to their minimum key, which ends up in bucket 0
+        void refill() {
+            while (true) {
+                u32 i = 1;
+                while (buckets[i].empty()) ++i;
+
+                u64 minBits = UINT64_MAX;
+                for (const Entry& entry : buckets[i]) {
+                    if (!isStale(entry) && entry.bits < minBits) minBits = entry.bits;
+                }
+
+                std::vector<Entry> entries;
+                entries.swap(buckets[i]);
+
+                // Every entry of the bucket was stale
+                if (minBits == UINT64_MAX) continue;
+
+                last = minBits;
+                for (const Entry& entry : entries) {
+                    if (!isStale(entry)) {
+                        buckets[bucketOf(entry.bits, last)].push_back(entry);
+                    }
+                }
+                return;
+            }
+        }
+};
+
+#endif // RADIX_HEAP_H
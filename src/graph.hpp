@@ -1,57 +1,351 @@
-
 #ifndef GRAPH_H
 #define GRAPH_H
 
-#include <list>
 #include <unordered_map>
-#include <string>
+#include <utility>
+#include <vector>
 #include "types.hpp"
 
+enum EdgeMetric {DISTANCE, TRAVEL_TIME};
+
+// Frozen directed graph in compressed sparse row form. Nodes are identified by
+// dense 32-bit indices; the outgoing edges of node i are the entries
+// [edgesBegin(i), edgesEnd(i)) of the target and weight arrays. The original
+// (OSM) identifiers are kept in a separate mapping. Every edge has a length and
+// a travel time; searches use the weights of the active metric.
 template <typename T>
 class Graph {
     public:
-        Graph() : adjList({}) {}
+        static constexpr u32 INVALID_INDEX = UINT32_MAX;
+
+        Graph() : offsets({0}) {}
+
+        Graph(std::vector<u64> ids, std::vector<T> nodes, std::vector<u32> offsets,
+                std::vector<u32> targets, std::vector<double> distances,
+                std::vector<double> travelTimes) : ids(std::move(ids)),
+                nodes(std::move(nodes)), offsets(std::move(offsets)),
+                targets(std::move(targets)), weights(std::move(distances)),
+                inactiveWeights(std::move(travelTimes)) {
+            indices.reserve(this->ids.size());
+            for (u32 i = 0; i < this->ids.size(); ++i) {
+                indices[this->ids[i]] = i;
+            }
+        }
+
+        u32 numNodes() const {
+            return nodes.size();
+        }
+
+        size_t numEdges() const {
+            return targets.size();
+        }
+
+        bool contains(u64 id) const {
+            return indices.count(id) != 0;
+        }
+
+        u32 getIndex(u64 id) const {
+            auto it = indices.find(id);
+            return it == indices.end() ? INVALID_INDEX : it->second;
+        }
+
+        u64 getId(u32 index) const {
+            return ids[index];
+        }
+
+        const T& getNode(u32 index) const {
+            return nodes[index];
+        }
+
+        T& getNode(u32 index) {
+            return nodes[index];
+        }
+
+        const std::vector<T>& getNodes() const {
+            return nodes;
+        }
+
+        std::vector<T>& getNodes() {
+            return nodes;
+        }
+
+        u32 edgesBegin(u32 index) const {
+            return offsets[index];
+        }
+
+        u32 edgesEnd(u32 index) const {
+            return offsets[index + 1];
+        }
+
+        u32 degree(u32 index) const {
+            return offsets[index + 1] - offsets[index];
+        }
+
+        u32 getTarget(u32 edge) const {
+            return targets[edge];
+        }
+
+        double getWeight(u32 edge) const {
+            return weights[edge];
+        }
+
+        const std::vector<u64>& getIds() const {
+            return ids;
+        }
+
+        const std::vector<u32>& getOffsets() const {
+            return offsets;
+        }
+
+        const std::vector<u32>& getTargets() const {
+            return targets;
+        }
+
+        const std::vector<double>& getWeights() const {
+            return weights;
+        }
+
+        const std::vector<double>& getDistances() const {
+            return metric == DISTANCE ? weights : inactiveWeights;
+        }
+
+        const std::vector<double>& getTravelTimes() const {
+            return metric == TRAVEL_TIME ? weights : inactiveWeights;
+        }
+
+        EdgeMetric getMetric() const {
+            return metric;
+        }
+
+        // The weights of the active metric are kept in the array read by
+        // searches, so switching metrics swaps the two arrays
+        void setMetric(EdgeMetric newMetric) {
+            if (newMetric != metric) {
+                std::swap(weights, inactiveWeights);
+                metric = newMetric;
+            }
+        }
+
+        // Identifies the structure of the graph and the weights of its active
+        // metric, so that data derived from it can be checked before reuse
+        u64 fingerprint() const {
+            u64 hash = 14695981039346656037ULL;
+            auto addBytes = [&hash](const void* data, size_t size) {
+                const u8* bytes = static_cast<const u8*>(data);
+                for (size_t i = 0; i < size; ++i) {
+                    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+                }
+            };
+
+            addBytes(ids.data(), ids.size() * sizeof(u64));
+            addBytes(offsets.data(), offsets.size() * sizeof(u32));
+            addBytes(targets.data(), targets.size() * sizeof(u32));
+            addBytes(weights.data(), weights.size() * sizeof(double));
+
+            return hash;
+        }
+
+        // Renumbers the nodes so that node order[i] becomes node i. The
+        // outgoing edges of each node keep their relative order.
+        void renumber(const std::vector<u32>& order) {
+            u32 n = numNodes();
+            std::vector<u32> newIndex(n);
+            for (u32 i = 0; i < n; ++i) {
+                newIndex[order[i]] = i;
+            }
+
+            std::vector<u64> newIds(n);
+            std::vector<T> newNodes;
+            newNodes.reserve(n);
+            std::vector<u32> newOffsets(n + 1, 0), newTargets(targets.size());
+            std::vector<double> newWeights(weights.size()), newInactiveWeights(weights.size());
+
+            for (u32 i = 0; i < n; ++i) {
+                u32 old = order[i];
+                newIds[i] = ids[old];
+                newNodes.push_back(nodes[old]);
+                indices[ids[old]] = i;
+
+                u32 pos = newOffsets[i];
+                for (u32 e = offsets[old]; e != offsets[old + 1]; ++e, ++pos) {
+                    newTargets[pos] = newIndex[targets[e]];
+                    newWeights[pos] = weights[e];
+                    newInactiveWeights[pos] = inactiveWeights[e];
+                }
+                newOffsets[i + 1] = pos;
+            }
+
+            ids = std::move(newIds);
+            nodes = std::move(newNodes);
+            offsets = std::move(newOffsets);
+            targets = std::move(newTargets);
+            weights = std::move(newWeights);
+            inactiveWeights = std::move(newInactiveWeights);
+        }
+    private:
+        std::vector<u64> ids;
+        std::unordered_map<u64, u32> indices;
+        std::vector<T> nodes;
+
+        std::vector<u32> offsets;
+        std::vector<u32> targets;
+        std::vector<double> weights;
+        std::vector<double> inactiveWeights;
+        EdgeMetric metric = DISTANCE;
+};
+
+// Incoming edges of a graph, in the same compressed sparse row form: the edges
+// of node i are the edges of the graph that end at i, and getTarget returns the
+// node they start from. Weights are those of the metric active when the view
+// was built.
+template <typename T>
+class ReverseGraph {
+    public:
+        explicit ReverseGraph(const Graph<T>& graph) : offsets(graph.numNodes() + 1, 0),
+                sources(graph.numEdges()), weights(graph.numEdges()) {
+            u32 n = graph.numNodes();
+            for (u32 e = 0; e < graph.numEdges(); ++e) {
+                ++offsets[graph.getTarget(e) + 1];
+            }
+            for (u32 i = 0; i < n; ++i) {
+                offsets[i + 1] += offsets[i];
+            }
+
+            std::vector<u32> positions(offsets.begin(), offsets.end() - 1);
+            for (u32 i = 0; i < n; ++i) {
+                for (u32 e = graph.edgesBegin(i); e != graph.edgesEnd(i); ++e) {
+                    u32 pos = positions[graph.getTarget(e)]++;
+                    sources[pos] = i;
+                    weights[pos] = graph.getWeight(e);
+                }
+            }
+        }
+
+        u32 numNodes() const {
+            return offsets.size() - 1;
+        }
+
+        u32 edgesBegin(u32 index) const {
+            return offsets[index];
+        }
+
+        u32 edgesEnd(u32 index) const {
+            return offsets[index + 1];
+        }
+
+        u32 getTarget(u32 edge) const {
+            return sources[edge];
+        }
+
+        double getWeight(u32 edge) const {
+            return weights[edge];
+        }
+    private:
+        std::vector<u32> offsets;
+        std::vector<u32> sources;
+        std::vector<double> weights;
+};
+
+// Mutable graph used while the road network is being read. Nodes receive
+// indices in insertion order and build() sorts the edges into a Graph.
+template <typename T>
+class GraphBuilder {
+    public:
+        struct Edge {
+            u32 from, to;
+            double distance, travelTime;
+        };
+
         void addNode(u64 id, T data) {
-            nodes[id] = data;
-            adjList[id] = {};
+            auto it = indices.find(id);
+            if (it != indices.end()) {
+                nodes[it->second] = data;
+                return;
+            }
+
+            indices[id] = ids.size();
+            ids.push_back(id);
+            nodes.push_back(data);
         }
 
-        void addEdge(u64 node1, u64 node2, double weight) {
-            if (adjList.count(node1) != 0 && adjList.count(node2) != 0) {
-                adjList[node1].push_back(std::make_pair(node2, weight));
+        void addEdge(u64 node1, u64 node2, double distance, double travelTime) {
+            auto it1 = indices.find(node1), it2 = indices.find(node2);
+            if (it1 != indices.end() && it2 != indices.end()) {
+                edges.push_back({it1->second, it2->second, distance, travelTime});
             }
         }
 
-        const T& getNode(u64 id) const {
-            return nodes.at(id);
+        void addEdges(const std::vector<Edge>& newEdges) {
+            edges.insert(edges.end(), newEdges.begin(), newEdges.end());
         }
 
-        T& getNode(u64 id) {
-            return nodes.at(id);
+        bool contains(u64 id) const {
+            return indices.count(id) != 0;
         }
 
-        const std::list<std::pair<u64, double>>& getEdges(u64 id) const {
-            return adjList.at(id);
+        u32 getIndex(u64 id) const {
+            auto it = indices.find(id);
+            return it == indices.end() ? Graph<T>::INVALID_INDEX : it->second;
         }
 
-        const std::unordered_map<u64, T>& getNodes() const {
+        const std::vector<T>& getNodes() const {
             return nodes;
         }
 
-        std::unordered_map<u64, T>& getNodes() {
-            return nodes;
+        const T& getNode(u64 id) const {
+            return nodes[indices.at(id)];
         }
 
-        size_t numEdges() const {
-            size_t n = 0;
-            for (const auto& p : adjList) {
-                n += p.second.size();
+        T& getNode(u64 id) {
+            return nodes[indices.at(id)];
+        }
+
+        size_t numNodes() const {
+            return nodes.size();
+        }
+
+        void reserveNodes(size_t n) {
+            ids.reserve(n);
+            nodes.reserve(n);
+            indices.reserve(n);
+        }
+
+        // Edges keep their insertion order within each source node
+        Graph<T> build() {
+            u32 n = nodes.size();
+            std::vector<u32> offsets(n + 1, 0), targets(edges.size());
+            std::vector<double> distances(edges.size()), travelTimes(edges.size());
+
+            for (const Edge& edge : edges) {
+                ++offsets[edge.from + 1];
+            }
+            for (u32 i = 0; i < n; ++i) {
+                offsets[i + 1] += offsets[i];
+            }
+
+            std::vector<u32> next(offsets.begin(), offsets.end() - 1);
+            for (const Edge& edge : edges) {
+                u32 pos = next[edge.from]++;
+                targets[pos] = edge.to;
+                distances[pos] = edge.distance;
+                travelTimes[pos] = edge.travelTime;
             }
-            return n;
+
+            Graph<T> graph(std::move(ids), std::move(nodes), std::move(offsets),
+                std::move(targets), std::move(distances), std::move(travelTimes));
+
+            indices.clear();
+            edges.clear();
+            ids.clear();
+            nodes.clear();
+
+            return graph;
         }
     private:
-        std::unordered_map<u64, T> nodes;
-        std::unordered_map<u64, std::list<std::pair<u64, double>>> adjList;
+        std::vector<u64> ids;
+        std::unordered_map<u64, u32> indices;
+        std::vector<T> nodes;
+        std::vector<Edge> edges;
 };
 
 #endif // GRAPH_H
@@ -5,12 +5,18 @@
 #include <cxxopts/cxxopts.hpp>
 
 #include "algorithms/a_star.hpp"
+#include "algorithms/contraction_hierarchy.hpp"
+#include "algorithms/landmarks.hpp"
 #include "analysis/complexity.hpp"
 #include "analysis/real_data.hpp"
 #include "cvrp/cvrp.hpp"
+#include "cvrp/distance_store.hpp"
+#include "cvrp/dm_cache.hpp"
 #include "cvrp/stage_1.hpp"
 #include "cvrp/stage_2.hpp"
 #include "cvrp/visualization.hpp"
+#include "osm/graph_cache.hpp"
+#include "osm/preprocessing.hpp"
 #include "utils.hpp"
 
 using namespace std;
@@ -19,6 +25,42 @@ static const unordered_set<string> algorithms = {
     "greedy", "cws", "sa", "gts", "aco"
 };
 
+static const unordered_map<string, NodeOrdering> nodeOrderings = {
+    {"osm", OSM_ORDER}, {"hilbert", HILBERT_CURVE}, {"rcm", REVERSE_CUTHILL_MCKEE}
+};
+
+static const unordered_map<string, EdgeMetric> metrics = {
+    {"distance", DISTANCE}, {"time", TRAVEL_TIME}
+};
+
+static const unordered_map<string, ShortestPathDataStructure> heaps = {
+    {"fib", FIBONACCI_HEAP}, {"bin", BINARY_HEAP}, {"radix", RADIX_HEAP}, {"dial", DIAL_BUCKETS},
+    {"4-ary", QUATERNARY_HEAP}, {"8-ary", OCTONARY_HEAP}
+};
+
+static const unordered_map<string, MatrixEngine> matrixEngines = {
+    {"dijkstra", DIJKSTRA_SEARCHES},
+    {"batched", BATCHED_SEARCHES}, {"delta", DELTA_STEPPING_SEARCHES}, {"ch", CH_QUERIES}, {"buckets", CH_BUCKETS},
+    {"phast", PHAST_SWEEPS}
+};
+
+// Landmarks selected for the A* searches that draw the solution
+static const u32 NUM_LANDMARKS = 8;
+
+// Number of times the crop margin is doubled before using the whole graph
+static const u32 MAX_CROP_ATTEMPTS = 3;
+
+// Reorders the road graph, restricts map matching to its largest component and
+// matches the instance locations to it
+static MapMatchingResult prepareGraph(OsmXmlData& data, const CvrpInstance& instance,
+        NodeOrdering nodeOrdering, MapMatchingDataStructure mmDataStructure, bool logs) {
+    reorderNodes(data, nodeOrdering, logs);
+    restrictToLargestComponent(data, logs);
+
+    cout << "Matching coordinates to OSM network nodes..." << endl;
+    return matchLocations(data, instance, mmDataStructure, logs);
+}
+
 int main(int argc, char** argv) {
     cxxopts::Options opts("cvrp", "Solver for large CVRP instances from the LoggiBUD dataset");
 
@@ -26,18 +68,30 @@ int main(int argc, char** argv) {
         .allow_unrecognised_options()
         .add_options()
         ("cvrp", "[REQ] Path to CVRP JSON file", cxxopts::value<string>())
-        ("osm", "[REQ] Path to OSM XML file", cxxopts::value<string>())
+        ("osm", "[REQ] Path to OSM XML or PBF (.pbf) file", cxxopts::value<string>())
         ("dm", "[OPT] Path to distance matrix", cxxopts::value<string>())
+        ("dm-cache", "[OPT] Path to a directory of distance matrices, reused by instances whose locations match the same road graph nodes", cxxopts::value<string>())
+        ("distance-store", "[OPT] Path to a store of distances between road graph nodes, shared by the instances of a region. Only the distances missing from it are computed (with Dijkstra's algorithm) and then added", cxxopts::value<string>())
+        ("graph-cache", "[OPT] Path to binary road graph cache (created from the OSM file if missing or outdated)", cxxopts::value<string>())
+        ("ch", "[OPT] Path to contraction hierarchy used for shortest paths (built from the road graph if missing or outdated)", cxxopts::value<string>())
+        ("matrix-engine", "[OPT] How the distance matrix is computed. Possibilities are: 'dijkstra', 'batched' (Dijkstra from 4 locations at once), 'delta' (delta-stepping, threads sharing each search), 'ch' (hierarchy queries), 'buckets' (many-to-many on the hierarchy) and 'phast' (one-to-all sweeps on the hierarchy). Defaults to 'ch' with `ch`, 'delta' with more threads than locations, 'dijkstra' otherwise", cxxopts::value<string>())
+        ("landmarks", "[OPT] Path to landmark distance tables used by A* to draw the solution (created if missing or outdated)", cxxopts::value<string>())
         ("vmm", "[OPT] Visualize map matching")
         ("vsp", "[OPT] Visualize shortest paths (for depot point)")
         ("vs", "[OPT] Visualize the CVRP solution obtained by the solver")
-        ("t,threads", "[OPT] Number of threads to use in shortest path calculation", cxxopts::value<u32>()->default_value("1"))
+        ("t,threads", "[OPT] Number of threads to use in OSM parsing and shortest path calculation", cxxopts::value<u32>()->default_value("1"))
         ("h,help", "[OPT] Print usage")
         ("l,logs", "[OPT] Enable additional execution logs")
         ("quadtree", "[OPT] Use quadtrees instead of k-d trees for map matching")
         ("bin-heap", "[OPT] Use binary heaps instead of Fibonacci heaps for Dijkstra's algorithm")
+        ("heap", "[OPT] Priority queue used by Dijkstra's algorithm. Possibilities are: 'fib', 'bin', 'radix', 'dial' (buckets of 1 metre or second), '4-ary' and '8-ary' (without decrease-key). Defaults to 'fib'", cxxopts::value<string>())
         ("a,algorithm", "[OPT] Algorithm used to solve the CVRP. Possibilities are: 'greedy', 'cws', 'sa', 'gts' and 'aco'. Defaults to 'cws'", cxxopts::value<string>())
         ("c,config", "[OPT] Use custom configuration for chosen CVRP algorithm")
+        ("contract", "[OPT] Contract chains of degree 2 road graph nodes before calculating shortest paths")
+        ("node-order", "[OPT] Order in which road graph nodes are stored in memory. Possibilities are: 'osm', 'hilbert' and 'rcm'. Defaults to 'hilbert'", cxxopts::value<string>())
+        ("profile", "[OPT] Path to JSON road profile (allowed highway classes, speeds and access restrictions)", cxxopts::value<string>())
+        ("metric", "[OPT] Edge weight used for shortest paths. Possibilities are: 'distance' (meters) and 'time' (seconds). Defaults to 'distance'", cxxopts::value<string>())
+        ("crop", "[OPT] Only keep the road graph within the given margin (in meters) of the instance's locations. The margin is increased if shortest paths change", cxxopts::value<double>())
         ;
 
     auto result = opts.parse(argc, argv);
@@ -57,6 +111,58 @@ int main(int argc, char** argv) {
         }
     }
 
+    NodeOrdering nodeOrdering = HILBERT_CURVE;
+    if (result.count("node-order")) {
+        string name = result["node-order"].as<string>();
+        if (!nodeOrderings.count(name)) {
+            cerr << "Error: `node-order` must be a valid node ordering (given: '"
+                << name << "')." << endl;
+            exit(1);
+        }
+        nodeOrdering = nodeOrderings.at(name);
+    }
+
+    EdgeMetric metric = DISTANCE;
+    if (result.count("metric")) {
+        string name = result["metric"].as<string>();
+        if (!metrics.count(name)) {
+            cerr << "Error: `metric` must be a valid edge metric (given: '"
+                << name << "')." << endl;
+            exit(1);
+        }
+        metric = metrics.at(name);
+    }
+
+    MatrixEngine matrixEngine = result.count("ch") ? CH_QUERIES : DIJKSTRA_SEARCHES;
+    if (result.count("matrix-engine")) {
+        string name = result["matrix-engine"].as<string>();
+        if (!matrixEngines.count(name)) {
+            cerr << "Error: `matrix-engine` must be a valid matrix engine (given: '"
+                << name << "')." << endl;
+            exit(1);
+        }
+        matrixEngine = matrixEngines.at(name);
+    }
+
+    double cropMargin = 0;
+    if (result.count("crop")) {
+        cropMargin = result["crop"].as<double>();
+        if (cropMargin <= 0) {
+            cerr << "Error: `crop` must be a positive margin in meters." << endl;
+            exit(1);
+        }
+    }
+
+    RoadProfile profile;
+    if (result.count("profile")) {
+        string profilePath = result["profile"].as<string>();
+        if (!profile.load(profilePath.c_str())) {
+            cerr << "Error: `profile` must be a path to a valid road profile (given: '"
+                << profilePath << "')." << endl;
+            exit(1);
+        }
+    }
+
     bool logs = result["logs"].as<bool>();
     u32 threads = result["threads"].as<u32>();
 
@@ -64,9 +170,19 @@ int main(int argc, char** argv) {
         solVis = result["vs"].as<bool>();
 
     bool config = result["config"].as<bool>();
+    bool contract = result["contract"].as<bool>();
 
     MapMatchingDataStructure mmDataStructure = result["quadtree"].as<bool>() ? QUADTREE : KD_TREE;
     ShortestPathDataStructure spDataStructure = result["bin-heap"].as<bool>() ? BINARY_HEAP : FIBONACCI_HEAP;
+    if (result.count("heap")) {
+        string name = result["heap"].as<string>();
+        if (!heaps.count(name)) {
+            cerr << "Error: `heap` must be a valid priority queue (given: '"
+                << name << "')." << endl;
+            exit(1);
+        }
+        spDataStructure = heaps.at(name);
+    }
 
     if (result.count("cvrp") && result.count("osm")) {
         string cvrpPath = result["cvrp"].as<string>(),
@@ -81,13 +197,108 @@ int main(int argc, char** argv) {
             }
         }
 
-        cout << "Parsing OSM XML..." << endl;
-        OsmXmlData data = parseOsmXml(osmPath.c_str());
+        string graphCachePath = "";
+        if (result.count("graph-cache")) {
+            graphCachePath = result["graph-cache"].as<string>();
+        }
+
+        OsmXmlData data;
+        bool readFromCache = false;
+
+        if (!graphCachePath.empty()) {
+            cout << "Loading road graph cache..." << endl;
+            readFromCache = readGraphCache(graphCachePath.c_str(), osmPath.c_str(), profile, data);
+        }
+
+        if (!readFromCache) {
+            cout << "Parsing OSM file..." << endl;
+            data = parseOsmFile(osmPath.c_str(), threads, logs, profile);
+
+            if (data.graph.numNodes() == 0) {
+                cerr << "Error: could not read a road network from `osm`." << endl;
+                exit(1);
+            }
+
+            if (!graphCachePath.empty()) {
+                writeGraphCache(graphCachePath.c_str(), osmPath.c_str(), profile, data);
+            }
+        }
+
+        data.graph.setMetric(metric);
 
         cout << "Parsing CVRP instance..." << endl;
         ifstream ifs(cvrpPath);
         CvrpInstance instance(ifs);
 
+        // With fewer locations than threads, searching one row per thread
+        // would leave threads idle
+        if (matrixEngine == DIJKSTRA_SEARCHES && !result.count("matrix-engine") &&
+                1 + instance.getDeliveries().size() < threads) {
+            matrixEngine = DELTA_STEPPING_SEARCHES;
+        }
+
+        string dmPath = "";
+        if (result.count("dm")) {
+            dmPath = result["dm"].as<string>();
+        }
+        string dmCacheDir = "";
+        if (result.count("dm-cache")) {
+            dmCacheDir = result["dm-cache"].as<string>();
+        }
+        string storePath = "";
+        if (result.count("distance-store")) {
+            storePath = result["distance-store"].as<string>();
+        }
+
+        // The store is shared by every instance of the region, so it must only
+        // get distances computed on the whole graph
+        if (cropMargin > 0 && !storePath.empty()) {
+            cout << "Not cropping the road graph, as `distance-store` keeps distances on the "
+                << "whole graph..." << endl;
+            cropMargin = 0;
+        }
+
+        MapMatchingResult mmResult;
+        if (cropMargin > 0) {
+            // The whole graph is matched too, to check that cropping does not
+            // change the matched nodes, and to spot check the distances between
+            // them
+            OsmXmlData full = move(data);
+            MapMatchingResult fullResult = prepareGraph(full, instance, nodeOrdering,
+                mmDataStructure, logs);
+
+            vector<u64> matchedNodes = {fullResult.originNode};
+            matchedNodes.insert(matchedNodes.end(), fullResult.deliveryNodes.begin(),
+                fullResult.deliveryNodes.end());
+
+            bool valid = false;
+            for (u32 attempt = 0; attempt < MAX_CROP_ATTEMPTS && !valid; ++attempt) {
+                cout << "Cropping road graph..." << endl;
+                data = cropToInstance(full, instance, cropMargin, logs);
+                mmResult = prepareGraph(data, instance, nodeOrdering, mmDataStructure, logs);
+
+                valid = mmResult.originNode == fullResult.originNode &&
+                    mmResult.deliveryNodes == fullResult.deliveryNodes &&
+                    spotCheckCrop(full, data, matchedNodes, logs);
+                cropMargin *= 2;
+            }
+
+            if (!valid) {
+                cout << "Cropping changes shortest paths, using the whole road graph..." << endl;
+                data = move(full);
+                mmResult = fullResult;
+            }
+        }
+        else {
+            mmResult = prepareGraph(data, instance, nodeOrdering, mmDataStructure, logs);
+        }
+
+        // Cached distances are keyed on the graph they are computed on, after
+        // any cropping (which is only spot checked, so it may change some of
+        // them) and before contraction (which does not)
+        u64 graphFingerprint = dmCacheDir.empty() && storePath.empty() ? 0
+            : data.graph.fingerprint();
+
         GraphVisualizationResult* gvr = nullptr;
         GraphViewer* gv = nullptr;
 
@@ -97,9 +308,6 @@ int main(int argc, char** argv) {
             gv = gvr->gv;
         }
 
-        cout << "Matching coordinates to OSM network nodes..." << endl;
-        MapMatchingResult mmResult = matchLocations(data, instance, mmDataStructure, logs);
-
         if (mmVis) {
             showMapMatchingResults(*gv, instance, mmResult);
             setGraphCenter(*gv, instance.getOrigin());
@@ -111,30 +319,103 @@ int main(int argc, char** argv) {
             gv->closeWindow();
         }
 
-        string dmPath = "";
-        if (result.count("dm")) {
-            dmPath = result["dm"].as<string>();
-        }
-        bool readFromFile = false;
+        bool readFromFile = false, readFromDmCache = false;
 
         {
             ifstream ifsDm(dmPath);
 
             if (ifsDm.is_open()) {
-                instance.readDistanceMatrixFromFile(dmPath.c_str());
-                readFromFile = true;
+                readFromFile = instance.readDistanceMatrixFromFile(dmPath.c_str());
+                if (!readFromFile) {
+                    cout << "Distance matrix in '" << dmPath
+                        << "' does not match the instance, recalculating..." << endl;
+                }
             }
         }
 
-        if (!readFromFile) {
+        if (!readFromFile && !dmCacheDir.empty()) {
+            readFromDmCache = readDistanceMatrixCache(dmCacheDir, graphFingerprint, mmResult, instance);
+            if (logs) {
+                cout << "Distance matrix cache " << (readFromDmCache ? "hit" : "miss") << " ("
+                    << distanceMatrixCachePath(dmCacheDir, graphFingerprint, mmResult) << ")\n";
+            }
+            if (readFromDmCache && !dmPath.empty()) {
+                instance.writeDistanceMatrixToFile(dmPath.c_str());
+            }
+        }
+
+        if (!readFromFile && !readFromDmCache) {
+            if (contract) {
+                cout << "Contracting road graph..." << endl;
+                vector<u64> matchedNodes = mmResult.deliveryNodes;
+                matchedNodes.push_back(mmResult.originNode);
+                contractDegreeTwoChains(data, matchedNodes, logs);
+            }
+
             cout << "Calculating shortest paths between matched nodes..." << endl;
-            calculateShortestPaths(data, instance, mmResult, spDataStructure, logs, threads);
+            if (!storePath.empty()) {
+                if (matrixEngine != DIJKSTRA_SEARCHES) {
+                    cout << "Computing the distances missing from `distance-store` with Dijkstra's "
+                        << "algorithm instead of the selected matrix engine..." << endl;
+                }
+
+                // A store that exists but can't be read is kept, as it may
+                // belong to another road graph of the region
+                DistanceStore store(graphFingerprint);
+                bool writeStore = store.read(storePath.c_str());
+                if (!writeStore) {
+                    writeStore = !ifstream(storePath).good();
+                    if (writeStore) {
+                        cout << "Starting a new distance store in '" << storePath << "'..." << endl;
+                    }
+                    else {
+                        cout << "Distance store in '" << storePath << "' belongs to another road "
+                            << "graph or is corrupt, it will not be updated..." << endl;
+                    }
+                }
+
+                calculateShortestPathsIncremental(data, instance, mmResult, store, spDataStructure,
+                    logs, threads);
+                if (writeStore && !store.write(storePath.c_str())) {
+                    cerr << "Warning: could not write the distance store to '" << storePath
+                        << "'." << endl;
+                }
+            }
+            else if (matrixEngine == DIJKSTRA_SEARCHES) {
+                calculateShortestPaths(data, instance, mmResult, spDataStructure, logs, threads);
+            }
+            else if (matrixEngine == BATCHED_SEARCHES) {
+                calculateShortestPathsBatched(data, instance, mmResult, logs, threads);
+            }
+            else if (matrixEngine == DELTA_STEPPING_SEARCHES) {
+                calculateShortestPathsDeltaStepping(data, instance, mmResult, logs, threads);
+            }
+            else {
+                string chPath = result.count("ch") ? result["ch"].as<string>() : "";
+                ContractionHierarchy ch;
+
+                if (chPath.empty() || !ch.read(chPath.c_str(), data.graph)) {
+                    cout << "Building contraction hierarchy..." << endl;
+                    ch.build(data.graph, logs);
+                    if (!chPath.empty()) ch.write(chPath.c_str());
+                }
+
+                if (matrixEngine == CH_QUERIES) {
+                    calculateShortestPathsHierarchy(data, ch, instance, mmResult, logs, threads);
+                }
+                else if (matrixEngine == CH_BUCKETS) {
+                    calculateShortestPathsBuckets(data, ch, instance, mmResult, logs, threads);
+                }
+                else {
+                    calculateShortestPathsPhast(data, ch, instance, mmResult, logs, threads);
+                }
+            }
             if (spVis) {
                 vector<ShortestPathResult> spResult = dijkstra(data.graph,
                     mmResult.originNode, mmResult.deliveryNodes, spDataStructure);
 
                 for (const auto& res : spResult) {
-                    highlightPath(*gvr, res.path);
+                    highlightPath(*gvr, unpackPath(data, res.path));
                 }
                 gv->setZipEdges(true);
 
@@ -146,6 +427,10 @@ int main(int argc, char** argv) {
             if (!dmPath.empty()) {
                 instance.writeDistanceMatrixToFile(dmPath.c_str());
             }
+            if (!dmCacheDir.empty() &&
+                    !writeDistanceMatrixCache(dmCacheDir, graphFingerprint, mmResult, instance)) {
+                cerr << "Warning: could not write the distance matrix to '" << dmCacheDir << "'." << endl;
+            }
         }
 
         cout << "Applying CVRP algorithm..." << endl;
@@ -156,7 +441,19 @@ int main(int argc, char** argv) {
             << " and uses " << solution.routes.size() << " vehicles." << endl;
 
         if (solVis) {
-            showSolution(*gvr, mmResult, data.graph, solution);
+            Landmarks landmarks;
+            bool useLandmarks = result.count("landmarks") != 0;
+
+            if (useLandmarks) {
+                string landmarksPath = result["landmarks"].as<string>();
+                if (!landmarks.read(landmarksPath.c_str(), data.graph)) {
+                    cout << "Selecting landmarks..." << endl;
+                    landmarks.select(data.graph, NUM_LANDMARKS, AVOID_LANDMARKS, logs);
+                    landmarks.write(landmarksPath.c_str());
+                }
+            }
+
+            showSolution(*gvr, mmResult, data, solution, useLandmarks ? &landmarks : nullptr);
             setGraphCenter(*gv, instance.getOrigin());
 
             gv->setZipEdges(true);
@@ -0,0 +1,158 @@
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "graph_cache.hpp"
+
+using namespace std;
+
+static const char GRAPH_CACHE_MAGIC[8] = {'C', 'V', 'R', 'P', 'G', 'R', 'P', 'H'};
+static const u32 GRAPH_CACHE_VERSION = 4;
+
+// File layout (native endianness): header, node ids (u64[n]), coordinates
+// (double[2n], latitude then longitude), edge distances (double[m]), edge travel
+// times (double[m]), CSR edge offsets (u32[n + 1]), edge targets as node
+// indices (u32[m]), map matching flags (u8[n])
+struct GraphCacheHeader {
+    char magic[8];
+    u32 version;
+    u32 reserved;
+    u64 sourceSize;
+    i64 sourceModified;
+    u64 profile;
+    u64 numNodes, numEdges;
+    double minLat, minLon, maxLat, maxLon;
+    double maxSpeed;
+};
+
+static size_t cacheSize(u64 numNodes, u64 numEdges) {
+    return sizeof(GraphCacheHeader) + numNodes * (sizeof(u64) + 2 * sizeof(double)) +
+        numEdges * (2 * sizeof(double) + sizeof(u32)) + (numNodes + 1) * sizeof(u32) +
+        numNodes * sizeof(u8);
+}
+
+static bool sourceStats(const char* osmPath, u64& size, i64& modified) {
+    struct stat st;
+    if (stat(osmPath, &st) != 0) return false;
+
+    size = st.st_size;
+    modified = st.st_mtime;
+    return true;
+}
+
+bool readGraphCache(const char* path, const char* osmPath, const RoadProfile& profile,
+        OsmXmlData& data) {
+    u64 sourceSize = 0;
+    i64 sourceModified = 0;
+    if (!sourceStats(osmPath, sourceSize, sourceModified)) return false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(GraphCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    const char* bytes = static_cast<const char*>(mapping);
+    GraphCacheHeader header;
+    memcpy(&header, bytes, sizeof(header));
+
+    bool valid = memcmp(header.magic, GRAPH_CACHE_MAGIC, sizeof(GRAPH_CACHE_MAGIC)) == 0 &&
+        header.version == GRAPH_CACHE_VERSION && header.sourceSize == sourceSize &&
+        header.sourceModified == sourceModified && header.profile == profile.fingerprint() &&
+        header.numNodes < Graph<OsmNode>::INVALID_INDEX && header.numEdges <= UINT32_MAX &&
+        size == cacheSize(header.numNodes, header.numEdges);
+
+    if (valid) {
+        madvise(mapping, size, MADV_SEQUENTIAL);
+
+        u64 n = header.numNodes, m = header.numEdges;
+        const u64* ids = reinterpret_cast<const u64*>(bytes + sizeof(GraphCacheHeader));
+        const double* coords = reinterpret_cast<const double*>(ids + n);
+        const double* distances = coords + 2 * n;
+        const double* travelTimes = distances + m;
+        const u32* offsets = reinterpret_cast<const u32*>(travelTimes + m);
+        const u32* targets = offsets + n + 1;
+        const u8* mapMatch = reinterpret_cast<const u8*>(targets + m);
+
+        // A corrupt or half-written cache of the right size would otherwise
+        // make searches read out of bounds
+        valid = offsets[0] == 0 && offsets[n] == m;
+        for (u64 i = 0; i < n && valid; ++i) {
+            valid = offsets[i] <= offsets[i + 1];
+        }
+        for (u64 e = 0; e < m && valid; ++e) {
+            valid = targets[e] < n;
+        }
+
+        if (valid) {
+            data.minCoords = Coordinates(header.minLat, header.minLon);
+            data.maxCoords = Coordinates(header.maxLat, header.maxLon);
+            data.maxSpeed = header.maxSpeed;
+
+            vector<OsmNode> nodes;
+            nodes.reserve(n);
+            for (u64 i = 0; i < n; ++i) {
+                OsmNode node = { ids[i], Coordinates(coords[2 * i], coords[2 * i + 1]) };
+                node.mapMatch = mapMatch[i] != 0;
+                nodes.push_back(node);
+            }
+
+            data.graph = Graph<OsmNode>(vector<u64>(ids, ids + n), move(nodes),
+                vector<u32>(offsets, offsets + n + 1), vector<u32>(targets, targets + m),
+                vector<double>(distances, distances + m), vector<double>(travelTimes, travelTimes + m));
+        }
+    }
+
+    munmap(mapping, size);
+    return valid;
+}
+
+void writeGraphCache(const char* path, const char* osmPath, const RoadProfile& profile,
+        const OsmXmlData& data) {
+    GraphCacheHeader header = {};
+    memcpy(header.magic, GRAPH_CACHE_MAGIC, sizeof(GRAPH_CACHE_MAGIC));
+    header.version = GRAPH_CACHE_VERSION;
+    sourceStats(osmPath, header.sourceSize, header.sourceModified);
+    header.profile = profile.fingerprint();
+    header.numNodes = data.graph.numNodes();
+    header.numEdges = data.graph.numEdges();
+    header.minLat = data.minCoords.getLatitude();
+    header.minLon = data.minCoords.getLongitude();
+    header.maxLat = data.maxCoords.getLatitude();
+    header.maxLon = data.maxCoords.getLongitude();
+    header.maxSpeed = data.maxSpeed;
+
+    const Graph<OsmNode>& graph = data.graph;
+    vector<double> coords;
+    vector<u8> mapMatch;
+    coords.reserve(2 * graph.numNodes());
+    mapMatch.reserve(graph.numNodes());
+
+    for (const OsmNode& node : graph.getNodes()) {
+        coords.push_back(node.coordinates.getLatitude());
+        coords.push_back(node.coordinates.getLongitude());
+        mapMatch.push_back(node.mapMatch);
+    }
+
+    ofstream ofs(path, ios::binary);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(graph.getIds().data()), graph.numNodes() * sizeof(u64));
+    ofs.write(reinterpret_cast<const char*>(coords.data()), coords.size() * sizeof(double));
+    ofs.write(reinterpret_cast<const char*>(graph.getDistances().data()), graph.numEdges() * sizeof(double));
+    ofs.write(reinterpret_cast<const char*>(graph.getTravelTimes().data()), graph.numEdges() * sizeof(double));
+    ofs.write(reinterpret_cast<const char*>(graph.getOffsets().data()), graph.getOffsets().size() * sizeof(u32));
+    ofs.write(reinterpret_cast<const char*>(graph.getTargets().data()), graph.numEdges() * sizeof(u32));
+    ofs.write(reinterpret_cast<const char*>(mapMatch.data()), mapMatch.size() * sizeof(u8));
+    ofs.close();
+}
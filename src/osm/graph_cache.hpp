@@ -0,0 +1,16 @@
+#ifndef GRAPH_CACHE_H
+#define GRAPH_CACHE_H
+
+#include "osm.hpp"
+
+// Loads a graph previously written by writeGraphCache. Returns false if the
+// cache does not exist, is corrupt, has a different format version or was built
+// from a different version of the OSM file or with a different road profile, in
+// which case data is left untouched.
+bool readGraphCache(const char* path, const char* osmPath, const RoadProfile& profile,
+    OsmXmlData& data);
+
+void writeGraphCache(const char* path, const char* osmPath, const RoadProfile& profile,
+    const OsmXmlData& data);
+
+#endif // GRAPH_CACHE_H
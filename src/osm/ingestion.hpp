@@ -0,0 +1,84 @@
+#ifndef OSM_INGESTION_H
+#define OSM_INGESTION_H
+
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "osm.hpp"
+#include "profile.hpp"
+
+// Building blocks shared by the OSM XML and PBF readers
+
+// Accumulates the tags of a way and decides, using the road profile, whether it
+// belongs to the road network and at what speed it is driven
+struct WayClassification {
+    const RoadProfile* profile;
+    bool highway = false, oneWay = false, valid = true;
+    u32 highwayClass = 0;
+    double maxspeed = 0;
+
+    explicit WayClassification(const RoadProfile& profile) : profile(&profile) {}
+
+    void addTag(std::string_view k, std::string_view v);
+
+    // Speed in km/h: that of the highway class, lowered by a maxspeed tag
+    double speed() const;
+
+    bool accepted() const {
+        return highway && valid && speed() > 0;
+    }
+};
+
+using GraphEdge = GraphBuilder<OsmNode>::Edge;
+
+// Appends the edges between consecutive nodes of a way, driven at the given
+// speed (km/h)
+void appendWayEdges(const GraphBuilder<OsmNode>& builder, const u64* first,
+    const u64* last, bool oneWay, double speed, std::vector<GraphEdge>& edges);
+
+// Builds the graph and computes the data derived from it
+void finishGraph(OsmXmlData& data, GraphBuilder<OsmNode>& builder);
+
+// Elements of one chunk of the file, merged with the other chunks in file order
+struct OsmChunk {
+    bool hasBounds = false;
+    Coordinates minCoords, maxCoords;
+    std::vector<OsmNode> nodes;
+
+    struct Way {
+        size_t end;
+        bool oneWay;
+        double speed;
+    };
+
+    // Node references of every accepted way, concatenated, and the end of each
+    // way in that vector
+    std::vector<u64> wayNodes;
+    std::vector<Way> ways;
+
+    std::vector<GraphEdge> edges;
+
+    void bounds(const Coordinates& minCoords, const Coordinates& maxCoords) {
+        hasBounds = true;
+        this->minCoords = minCoords;
+        this->maxCoords = maxCoords;
+    }
+
+    void node(const OsmNode& node) {
+        nodes.push_back(node);
+    }
+
+    void way(const std::vector<u64>& nodes, const WayClassification& classification) {
+        wayNodes.insert(wayNodes.end(), nodes.begin(), nodes.end());
+        ways.push_back({wayNodes.size(), classification.oneWay, classification.speed()});
+    }
+};
+
+// Adds the nodes of every chunk to the graph, then the edges of every way, in
+// chunk order. Edges are created in parallel. The chunks are emptied. With
+// printLogs, the time spent merging nodes, creating edges and building the CSR
+// graph is printed.
+void buildGraphFromChunks(OsmXmlData& data, std::vector<OsmChunk>& chunks, u32 numThreads,
+    bool printLogs = false);
+
+#endif // OSM_INGESTION_H
@@ -1,16 +1,150 @@
-
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <iostream>
-#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <tinyxml/tinyxml2.h>
+#include "ingestion.hpp"
 #include "osm.hpp"
+#include "../utils.hpp"
 
 using namespace std;
+using chrono::high_resolution_clock;
+using chrono::milliseconds;
 using tinyxml2::XMLDocument;
 using tinyxml2::XMLElement;
 using tinyxml2::XMLError;
 
-OsmXmlData parseOsmXml(const char* path) {
+// Size of the read buffer used by the streaming parser (grows if a single
+// element does not fit)
+static const size_t STREAM_BUFFER_SIZE = 1 << 22;
+
+void WayClassification::addTag(string_view k, string_view v) {
+    if (k == "highway") {
+        highway = true;
+        highwayClass = profile->highwayClass(v);
+    }
+    else if (k == "oneway" && v == "yes") {
+        oneWay = true;
+    }
+    else if (k == "maxspeed") {
+        if (profile->usesMaxspeedTag()) maxspeed = parseMaxspeed(v);
+    }
+    else if (profile->isAccessTag(k) && profile->deniesAccess(v)) {
+        valid = false;
+    }
+}
+
+double WayClassification::speed() const {
+    // A maxspeed tag is a legal limit, which may be above what the profile's
+    // vehicle drives on that class of road
+    double classSpeed = profile->classSpeed(highwayClass);
+    if (classSpeed == 0 || maxspeed <= 0) return classSpeed;
+
+    return min({classSpeed, maxspeed, profile->getMaxSpeed()});
+}
+
+void appendWayEdges(const GraphBuilder<OsmNode>& builder, const u64* first,
+        const u64* last, bool oneWay, double speed, vector<GraphEdge>& edges) {
+    static const u32 NONE = Graph<OsmNode>::INVALID_INDEX;
+    const vector<OsmNode>& nodes = builder.getNodes();
+
+    for (const u64* it = first; it + 1 < last; ++it) {
+        u32 idx1 = builder.getIndex(*it), idx2 = builder.getIndex(*(it + 1));
+
+        // Ways may reference nodes outside of the extract
+        if (idx1 == NONE || idx2 == NONE) continue;
+
+        double distance = nodes[idx1].coordinates.haversine(nodes[idx2].coordinates);
+        double travelTime = distance / (speed / 3.6);
+        edges.push_back({idx1, idx2, distance, travelTime});
+        if (!oneWay) {
+            edges.push_back({idx2, idx1, distance, travelTime});
+        }
+    }
+}
+
+void finishGraph(OsmXmlData& data, GraphBuilder<OsmNode>& builder) {
+    data.graph = builder.build();
+
+    // Do not include nodes with degree 0 in map matching
+    for (u32 i = 0; i < data.graph.numNodes(); ++i) {
+        if (data.graph.degree(i) == 0) {
+            data.graph.getNode(i).mapMatch = false;
+        }
+    }
+
+    const vector<double>& distances = data.graph.getDistances();
+    const vector<double>& travelTimes = data.graph.getTravelTimes();
+    data.maxSpeed = 0;
+    for (size_t e = 0; e < distances.size(); ++e) {
+        if (travelTimes[e] > 0) data.maxSpeed = max(data.maxSpeed, distances[e] / travelTimes[e] * 3.6);
+    }
+}
+
+void buildGraphFromChunks(OsmXmlData& data, vector<OsmChunk>& chunks, u32 numThreads,
+        bool printLogs) {
+    auto t0 = high_resolution_clock::now();
+
+    GraphBuilder<OsmNode> builder;
+    size_t numNodes = 0;
+    for (const OsmChunk& chunk : chunks) {
+        numNodes += chunk.nodes.size();
+    }
+    builder.reserveNodes(numNodes);
+
+    for (OsmChunk& chunk : chunks) {
+        if (chunk.hasBounds) {
+            data.minCoords = chunk.minCoords;
+            data.maxCoords = chunk.maxCoords;
+        }
+        for (const OsmNode& node : chunk.nodes) {
+            builder.addNode(node.id, node);
+        }
+        chunk.nodes = vector<OsmNode>();
+    }
+
+    auto t1 = high_resolution_clock::now();
+
+    runParallel(chunks.size(), numThreads, [&](size_t i) {
+        OsmChunk& chunk = chunks[i];
+        size_t first = 0;
+
+        for (const auto& way : chunk.ways) {
+            appendWayEdges(builder, chunk.wayNodes.data() + first,
+                chunk.wayNodes.data() + way.end, way.oneWay, way.speed, chunk.edges);
+            first = way.end;
+        }
+    });
+
+    auto t2 = high_resolution_clock::now();
+
+    for (OsmChunk& chunk : chunks) {
+        builder.addEdges(chunk.edges);
+        chunk = OsmChunk();
+    }
+
+    finishGraph(data, builder);
+
+    auto t3 = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Built road graph: merging nodes " << interval<milliseconds>(t0, t1)
+            << "ms, creating edges " << interval<milliseconds>(t1, t2)
+            << "ms, building CSR graph " << interval<milliseconds>(t2, t3) << "ms\n";
+    }
+}
+
+OsmXmlData parseOsmXmlDom(const char* path, const RoadProfile& profile) {
     OsmXmlData data;
 
     XMLDocument doc;
@@ -28,6 +162,8 @@ OsmXmlData parseOsmXml(const char* path) {
         stod(bounds->Attribute("maxlon"))
     );
 
+    GraphBuilder<OsmNode> builder;
+
     const XMLElement* nodeElement = root->FirstChildElement("node");
     while (nodeElement != nullptr) {
         u64 id = stoull(nodeElement->Attribute("id"));
@@ -35,76 +171,390 @@ OsmXmlData parseOsmXml(const char* path) {
             stod(nodeElement->Attribute("lat")),
             stod(nodeElement->Attribute("lon"))
         ) };
-        data.graph.addNode(id, node);
+        builder.addNode(id, node);
 
         nodeElement = nodeElement->NextSiblingElement("node");
     }
 
-    static const unordered_set<string> invalidHighwayValues = {
-        "pedestrian", "track", "escape", "raceway", "busway", "bus_guideway",
-        "footway", "bridleway", "steps", "corridor", "path", "cycleway",
-        "proposed", "construction", "elevator"
-    };
+    vector<u64> wayNodes;
+    vector<GraphEdge> edges;
 
     const XMLElement* way = root->FirstChildElement("way");
     while (way != nullptr) {
-        bool oneWay = false, valid = true, highway = false;
+        WayClassification classification(profile);
 
         const XMLElement* tag = way->FirstChildElement("tag");
         while (tag != nullptr) {
-            if (tag->Attribute("k", "highway")) highway = true;
+            classification.addTag(tag->Attribute("k"), tag->Attribute("v"));
+            tag = tag->NextSiblingElement("tag");
+        }
 
-            if (tag->Attribute("k", "oneway") && tag->Attribute("v", "yes")) {
-                oneWay = true;
+        if (classification.accepted()) {
+            wayNodes.clear();
+
+            const XMLElement* nd = way->FirstChildElement("nd");
+            while (nd != nullptr) {
+                wayNodes.push_back(stoull(nd->Attribute("ref")));
+                nd = nd->NextSiblingElement("nd");
             }
 
-            if ((tag->Attribute("k", "access") && tag->Attribute("v", "no")) ||
-                (tag->Attribute("k", "highway") && invalidHighwayValues.count(tag->Attribute("v")) != 0)) {
-                valid = false;
+            edges.clear();
+            appendWayEdges(builder, wayNodes.data(), wayNodes.data() + wayNodes.size(),
+                classification.oneWay, classification.speed(), edges);
+            builder.addEdges(edges);
+        }
+
+        way = way->NextSiblingElement("way");
+    }
+
+    finishGraph(data, builder);
+
+    return data;
+}
+
+using XmlAttributes = vector<pair<string_view, string_view>>;
+
+inline bool isXmlSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Parses every complete element in [begin, end), forwarding start and end tags
+// to the handler. Returns a pointer to the first byte that could not be parsed
+// because the buffer ends in the middle of a tag. Entities in attribute values
+// are not decoded, since none of the attributes we use can contain them.
+template <typename Handler>
+const char* scanXmlElements(const char* begin, const char* end, Handler& handler) {
+    XmlAttributes attributes;
+    const char* p = begin;
+
+    while (true) {
+        const char* tagStart = static_cast<const char*>(memchr(p, '<', end - p));
+        if (tagStart == nullptr) return end;
+        p = tagStart + 1;
+        if (p == end) return tagStart;
+
+        if (*p == '?' || *p == '!') {
+            // Declaration, comment or doctype
+            bool comment = end - p >= 3 && p[1] == '-' && p[2] == '-';
+            const char* close = nullptr;
+
+            if (comment) {
+                string_view rest(p + 3, end - p - 3);
+                size_t pos = rest.find("-->");
+                if (pos != string_view::npos) close = p + 3 + pos + 2;
+            }
+            else {
+                close = static_cast<const char*>(memchr(p, '>', end - p));
             }
 
-            tag = tag->NextSiblingElement("tag");
+            if (close == nullptr) return tagStart;
+            p = close + 1;
+            continue;
         }
 
-        if (!highway) valid = false;
+        bool endTag = *p == '/';
+        if (endTag) ++p;
 
-        if (valid) {
-            list<u64> wayNodes;
+        const char* nameStart = p;
+        while (p != end && !isXmlSpace(*p) && *p != '>' && *p != '/') ++p;
+        if (p == end) return tagStart;
+        string_view name(nameStart, p - nameStart);
 
-            const XMLElement* n1 = way->FirstChildElement("nd");
-            const XMLElement* n2 = n1->NextSiblingElement("nd");
+        if (endTag) {
+            p = static_cast<const char*>(memchr(p, '>', end - p));
+            if (p == nullptr) return tagStart;
+            ++p;
+            handler.endElement(name);
+            continue;
+        }
 
-            u64 id1 = stoull(n1->Attribute("ref")), id2;
-            wayNodes.push_back(id1);
+        attributes.clear();
+        bool selfClosing = false, complete = false;
 
-            while (n2 != nullptr) {
-                id2 = stoull(n2->Attribute("ref"));
-                wayNodes.push_back(id2);
+        while (p != end) {
+            while (p != end && isXmlSpace(*p)) ++p;
+            if (p == end) break;
 
-                const OsmNode& data1 = data.graph.getNode(id1),
-                    data2 = data.graph.getNode(id2);
+            if (*p == '>') {
+                complete = true;
+                ++p;
+                break;
+            }
+            if (*p == '/') {
+                if (end - p < 2) break;
+                selfClosing = complete = true;
+                p += 2;
+                break;
+            }
 
-                double weight = data1.coordinates.haversine(data2.coordinates);
-                data.graph.addEdge(id1, id2, weight);
-                if (!oneWay) {
-                    data.graph.addEdge(id2, id1, weight);
-                }
+            const char* attrStart = p;
+            while (p != end && *p != '=' && !isXmlSpace(*p)) ++p;
+            string_view attrName(attrStart, p - attrStart);
+            while (p != end && *p != '"' && *p != '\'') ++p;
+            if (p == end) break;
+
+            char quote = *p++;
+            const char* valueEnd = static_cast<const char*>(memchr(p, quote, end - p));
+            if (valueEnd == nullptr) break;
+
+            attributes.emplace_back(attrName, string_view(p, valueEnd - p));
+            p = valueEnd + 1;
+        }
+
+        if (!complete) return tagStart;
+
+        handler.startElement(name, attributes);
+        if (selfClosing) handler.endElement(name);
+    }
+}
+
+inline string_view findAttribute(const XmlAttributes& attributes, string_view name) {
+    for (const auto& attribute : attributes) {
+        if (attribute.first == name) return attribute.second;
+    }
+    return {};
+}
+
+template <typename T>
+T parseNumber(string_view str) {
+    T value = 0;
+    from_chars(str.data(), str.data() + str.size(), value);
+    return value;
+}
+
+// Adds nodes and edges to the graph as soon as they are read. OSM files list
+// every node before the first way, so edges can be created as soon as a way is
+// closed.
+class GraphSink {
+    public:
+        GraphSink(OsmXmlData& data, GraphBuilder<OsmNode>& builder) : data(data),
+            builder(builder) {}
+
+        void bounds(const Coordinates& minCoords, const Coordinates& maxCoords) {
+            data.minCoords = minCoords;
+            data.maxCoords = maxCoords;
+        }
+
+        void node(const OsmNode& node) {
+            builder.addNode(node.id, node);
+        }
+
+        void way(const vector<u64>& wayNodes, const WayClassification& classification) {
+            edges.clear();
+            appendWayEdges(builder, wayNodes.data(), wayNodes.data() + wayNodes.size(),
+                classification.oneWay, classification.speed(), edges);
+            builder.addEdges(edges);
+        }
+    private:
+        OsmXmlData& data;
+        GraphBuilder<OsmNode>& builder;
+        vector<GraphEdge> edges;
+};
+
+template <typename Sink>
+class OsmXmlHandler {
+    public:
+        OsmXmlHandler(Sink& sink, const RoadProfile& profile) : sink(sink),
+            profile(profile), classification(profile) {}
+
+        void startElement(string_view name, const XmlAttributes& attributes) {
+            if (name == "node") {
+                u64 id = parseNumber<u64>(findAttribute(attributes, "id"));
+                OsmNode node = { id, Coordinates(
+                    parseNumber<double>(findAttribute(attributes, "lat")),
+                    parseNumber<double>(findAttribute(attributes, "lon"))
+                ) };
+                sink.node(node);
+            }
+            else if (name == "nd") {
+                if (inWay) wayNodes.push_back(parseNumber<u64>(findAttribute(attributes, "ref")));
+            }
+            else if (name == "tag") {
+                if (inWay) classification.addTag(findAttribute(attributes, "k"), findAttribute(attributes, "v"));
+            }
+            else if (name == "way") {
+                inWay = true;
+                classification = WayClassification(profile);
+                wayNodes.clear();
+            }
+            else if (name == "bounds") {
+                sink.bounds(
+                    Coordinates(
+                        parseNumber<double>(findAttribute(attributes, "minlat")),
+                        parseNumber<double>(findAttribute(attributes, "minlon"))
+                    ),
+                    Coordinates(
+                        parseNumber<double>(findAttribute(attributes, "maxlat")),
+                        parseNumber<double>(findAttribute(attributes, "maxlon"))
+                    )
+                );
+            }
+        }
 
-                n1 = n2;
-                id1 = id2;
-                n2 = n2->NextSiblingElement("nd");
+        void endElement(string_view name) {
+            if (name == "way" && inWay) {
+                if (classification.accepted()) {
+                    sink.way(wayNodes, classification);
+                }
+                inWay = false;
             }
         }
+    private:
+        Sink& sink;
+        const RoadProfile& profile;
 
-        way = way->NextSiblingElement("way");
+        bool inWay = false;
+        WayClassification classification;
+        vector<u64> wayNodes;
+};
+
+static OsmXmlData parseOsmXmlStreaming(const char* path, const RoadProfile& profile) {
+    OsmXmlData data;
+    GraphBuilder<OsmNode> builder;
+    GraphSink sink(data, builder);
+    OsmXmlHandler<GraphSink> handler(sink, profile);
+
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        cerr << "Error: could not open OSM file '" << path << "'." << endl;
+        return data;
     }
 
-    // Do not include nodes with degree 0 in map matching
-    for (auto& p : data.graph.getNodes()) {
-        if (data.graph.getEdges(p.first).empty()) {
-            p.second.mapMatch = false;
+    vector<char> buffer(STREAM_BUFFER_SIZE);
+    size_t filled = 0;
+
+    while (true) {
+        size_t read = fread(buffer.data() + filled, 1, buffer.size() - filled, file);
+        filled += read;
+
+        const char* begin = buffer.data();
+        const char* stop = scanXmlElements(begin, begin + filled, handler);
+        size_t remaining = begin + filled - stop;
+
+        if (read == 0) break;
+
+        if (remaining == buffer.size()) {
+            // A single element does not fit in the buffer
+            buffer.resize(buffer.size() * 2);
         }
+        else {
+            memmove(buffer.data(), stop, remaining);
+        }
+        filled = remaining;
     }
 
+    fclose(file);
+
+    finishGraph(data, builder);
+
     return data;
 }
+
+// Returns the start of the first node, way or relation element at or after p
+static const char* nextTopLevelElement(const char* p, const char* end) {
+    static const array<string_view, 3> names = {"node", "way", "relation"};
+
+    while (true) {
+        p = static_cast<const char*>(memchr(p, '<', end - p));
+        if (p == nullptr) return end;
+
+        string_view rest(p + 1, end - p - 1);
+        for (string_view name : names) {
+            if (rest.size() > name.size() && rest.compare(0, name.size(), name) == 0 &&
+                    (isXmlSpace(rest[name.size()]) || rest[name.size()] == '>')) {
+                return p;
+            }
+        }
+        ++p;
+    }
+}
+
+// The file is memory-mapped and split into chunks at element boundaries. Nodes
+// and ways are read in parallel, then merged in file order so that the result
+// is identical to the sequential parser.
+static OsmXmlData parseOsmXmlParallel(const char* path, u32 numThreads, bool printLogs,
+        const RoadProfile& profile) {
+    static const u32 CHUNKS_PER_THREAD = 4;
+
+    OsmXmlData data;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        cerr << "Error: could not open OSM file '" << path << "'." << endl;
+        if (fd >= 0) close(fd);
+        return data;
+    }
+
+    size_t size = st.st_size;
+    void* mapping = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        cerr << "Error: could not map OSM file '" << path << "'." << endl;
+        return data;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    auto t0 = high_resolution_clock::now();
+
+    const char* begin = static_cast<const char*>(mapping);
+    const char* end = begin + size;
+
+    size_t numChunks = (size_t) numThreads * CHUNKS_PER_THREAD;
+    vector<const char*> boundaries = {begin};
+    for (size_t i = 1; i < numChunks; ++i) {
+        const char* boundary = nextTopLevelElement(max(begin + size / numChunks * i,
+            boundaries.back()), end);
+        boundaries.push_back(boundary);
+    }
+    boundaries.push_back(end);
+
+    vector<OsmChunk> chunks(numChunks);
+    runParallel(numChunks, numThreads, [&](size_t i) {
+        OsmXmlHandler<OsmChunk> handler(chunks[i], profile);
+        scanXmlElements(boundaries[i], boundaries[i + 1], handler);
+    });
+
+    auto t1 = high_resolution_clock::now();
+
+    munmap(mapping, size);
+
+    buildGraphFromChunks(data, chunks, numThreads, printLogs);
+
+    auto t2 = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Parsed OSM XML with " << numThreads << " threads: scanning "
+            << interval<milliseconds>(t0, t1) << "ms, building graph "
+            << interval<milliseconds>(t1, t2) << "ms\n";
+    }
+
+    return data;
+}
+
+OsmXmlData parseOsmXml(const char* path, u32 numThreads, bool printLogs,
+        const RoadProfile& profile) {
+    if (numThreads > 1) {
+        return parseOsmXmlParallel(path, numThreads, printLogs, profile);
+    }
+
+    auto start = high_resolution_clock::now();
+    OsmXmlData data = parseOsmXmlStreaming(path, profile);
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Parsed OSM XML in " << interval<milliseconds>(start, end) << "ms\n";
+    }
+
+    return data;
+}
+
+OsmXmlData parseOsmFile(const char* path, u32 numThreads, bool printLogs,
+        const RoadProfile& profile) {
+    string_view name(path);
+    if (name.size() >= 4 && name.compare(name.size() - 4, 4, ".pbf") == 0) {
+        return parseOsmPbf(path, numThreads, printLogs, profile);
+    }
+
+    return parseOsmXml(path, numThreads, printLogs, profile);
+}
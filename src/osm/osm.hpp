@@ -2,8 +2,12 @@
 #ifndef OSM_H
 #define OSM_H
 
+#include <unordered_map>
+#include <vector>
 #include "../coordinates.hpp"
 #include "../graph.hpp"
+#include "profile.hpp"
+#include "../utils.hpp"
 
 struct OsmNode {
     u64 id;
@@ -14,8 +18,40 @@ struct OsmNode {
 struct OsmXmlData {
     Graph<OsmNode> graph;
     Coordinates minCoords, maxCoords;
+
+    // Highest speed of any edge in km/h, which bounds the travel time of a
+    // straight line
+    double maxSpeed = 0;
+
+    // Nodes removed from the graph by chain contraction, indexed by the OSM
+    // ids of the endpoints of the edge that replaced them (in path order)
+    std::unordered_map<std::pair<u64, u64>, std::vector<OsmNode>, PairHash> edgeGeometry;
 };
 
-OsmXmlData parseOsmXml(const char* path);
+// Streams the file through a fixed-size buffer, so memory usage is bounded by
+// the size of the resulting graph rather than the size of the XML document.
+// With more than one thread, the file is memory-mapped and split into chunks
+// that are parsed in parallel.
+OsmXmlData parseOsmXml(const char* path, u32 numThreads = 1, bool printLogs = false,
+    const RoadProfile& profile = RoadProfile());
+
+// Loads the whole document with tinyxml2 before building the graph
+OsmXmlData parseOsmXmlDom(const char* path, const RoadProfile& profile = RoadProfile());
+
+// Reads an OSM PBF file (zlib-compressed blocks only), decoding the blocks in
+// parallel. The result is the same as parsing the equivalent XML file.
+OsmXmlData parseOsmPbf(const char* path, u32 numThreads = 1, bool printLogs = false,
+    const RoadProfile& profile = RoadProfile());
+
+// Uses the PBF reader for files with the .pbf extension and the XML parser otherwise
+OsmXmlData parseOsmFile(const char* path, u32 numThreads = 1, bool printLogs = false,
+    const RoadProfile& profile = RoadProfile());
+
+// Lower bound on the cost of travelling one metre in the active metric, which
+// keeps straight-line heuristics admissible
+inline double costPerMeterBound(const OsmXmlData& data) {
+    if (data.graph.getMetric() != TRAVEL_TIME) return 1;
+    return data.maxSpeed > 0 ? 3.6 / data.maxSpeed : 0;
+}
 
 #endif
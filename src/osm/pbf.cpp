@@ -0,0 +1,473 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "ingestion.hpp"
+#include "osm.hpp"
+#include "../utils.hpp"
+
+using namespace std;
+using chrono::high_resolution_clock;
+using chrono::milliseconds;
+
+// Limits from the OSM PBF specification
+static const u32 MAX_BLOB_HEADER_SIZE = 64 * 1024;
+static const u32 MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+static const u32 WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_BYTES = 2, WIRE_FIXED32 = 5;
+
+inline i64 zigZagDecode(u64 value) {
+    return (i64) (value >> 1) ^ -(i64) (value & 1);
+}
+
+// Minimal reader for the protobuf wire format. Reading past the end of the
+// message (truncated or corrupt data) sets the error flag and stops.
+class ProtoReader {
+    public:
+        ProtoReader() {}
+
+        ProtoReader(const u8* begin, const u8* end) : p(begin), end(end) {}
+
+        explicit ProtoReader(string_view bytes) : ProtoReader(
+            reinterpret_cast<const u8*>(bytes.data()),
+            reinterpret_cast<const u8*>(bytes.data() + bytes.size())) {}
+
+        // Reads the key of the next field, returning false at the end of the message
+        bool next() {
+            if (p >= end || error) return false;
+
+            u64 key = varint();
+            field = key >> 3;
+            wireType = key & 7;
+            return !error;
+        }
+
+        u32 getField() const {
+            return field;
+        }
+
+        u32 getWireType() const {
+            return wireType;
+        }
+
+        bool hasError() const {
+            return error;
+        }
+
+        u64 varint() {
+            u64 value = 0;
+            for (u32 shift = 0; shift < 64; shift += 7) {
+                if (p >= end) break;
+
+                u8 byte = *p++;
+                value |= (u64) (byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) return value;
+            }
+
+            fail();
+            return 0;
+        }
+
+        i64 svarint() {
+            return zigZagDecode(varint());
+        }
+
+        string_view bytes() {
+            u64 length = varint();
+            if (error || length > (u64) (end - p)) {
+                fail();
+                return string_view();
+            }
+
+            string_view result(reinterpret_cast<const char*>(p), length);
+            p += length;
+            return result;
+        }
+
+        void skip() {
+            switch (wireType) {
+                case WIRE_VARINT: varint(); break;
+                case WIRE_FIXED64: advance(8); break;
+                case WIRE_BYTES: bytes(); break;
+                case WIRE_FIXED32: advance(4); break;
+                default: fail();
+            }
+        }
+
+        // Calls f with every value of a repeated integer field, which may be
+        // packed or not
+        template <typename F>
+        void forEachVarint(F f) {
+            if (wireType == WIRE_VARINT) {
+                f(varint());
+            }
+            else {
+                ProtoReader packed(bytes());
+                while (packed.p < packed.end && !packed.error) {
+                    f(packed.varint());
+                }
+                if (packed.error) fail();
+            }
+        }
+    private:
+        const u8* p = nullptr;
+        const u8* end = nullptr;
+        u32 field = 0, wireType = 0;
+        bool error = false;
+
+        void advance(size_t n) {
+            if (n > (size_t) (end - p)) fail();
+            else p += n;
+        }
+
+        void fail() {
+            error = true;
+            p = end;
+        }
+};
+
+struct PbfBlob {
+    string_view type;
+    string_view data;
+};
+
+// Decompresses a Blob message into buffer, returning false if the blob is
+// malformed or uses a compression method other than zlib
+static bool decodeBlob(string_view blob, vector<u8>& buffer) {
+    ProtoReader reader(blob);
+    string_view raw, zlibData;
+    u64 rawSize = 0;
+
+    while (reader.next()) {
+        switch (reader.getField()) {
+            case 1: raw = reader.bytes(); break;
+            case 2: rawSize = reader.varint(); break;
+            case 3: zlibData = reader.bytes(); break;
+            case 4: case 5: case 6: case 7:
+                cerr << "Error: unsupported PBF blob compression." << endl;
+                return false;
+            default: reader.skip();
+        }
+    }
+    if (reader.hasError()) return false;
+
+    if (!raw.empty()) {
+        buffer.assign(raw.begin(), raw.end());
+        return true;
+    }
+    if (rawSize > MAX_BLOB_SIZE) return false;
+
+    buffer.resize(rawSize);
+    uLongf size = rawSize;
+    int status = uncompress(buffer.data(), &size,
+        reinterpret_cast<const Bytef*>(zlibData.data()), zlibData.size());
+
+    return status == Z_OK && size == rawSize;
+}
+
+// Reads the bounding box of an OSMHeader block (in nanodegrees)
+static bool readHeaderBlock(const vector<u8>& block, OsmChunk& chunk) {
+    ProtoReader reader(block.data(), block.data() + block.size());
+
+    while (reader.next()) {
+        if (reader.getField() == 1 && reader.getWireType() == WIRE_BYTES) {
+            ProtoReader bbox(reader.bytes());
+            i64 left = 0, right = 0, top = 0, bottom = 0;
+
+            while (bbox.next()) {
+                switch (bbox.getField()) {
+                    case 1: left = bbox.svarint(); break;
+                    case 2: right = bbox.svarint(); break;
+                    case 3: top = bbox.svarint(); break;
+                    case 4: bottom = bbox.svarint(); break;
+                    default: bbox.skip();
+                }
+            }
+            if (bbox.hasError()) return false;
+
+            chunk.bounds(Coordinates(bottom * 1e-9, left * 1e-9), Coordinates(top * 1e-9, right * 1e-9));
+        }
+        else if (reader.getField() == 4 && reader.getWireType() == WIRE_BYTES) {
+            string_view feature = reader.bytes();
+            if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+                cerr << "Error: unsupported PBF feature '" << feature << "'." << endl;
+                return false;
+            }
+        }
+        else {
+            reader.skip();
+        }
+    }
+
+    return !reader.hasError();
+}
+
+// Coordinate transformation of a PrimitiveBlock
+struct BlockGranularity {
+    i64 granularity = 100;
+    i64 latOffset = 0, lonOffset = 0;
+
+    Coordinates coordinates(i64 lat, i64 lon) const {
+        return Coordinates((latOffset + granularity * lat) * 1e-9,
+            (lonOffset + granularity * lon) * 1e-9);
+    }
+};
+
+static bool readNode(string_view message, const BlockGranularity& block, OsmChunk& chunk) {
+    ProtoReader reader(message);
+    i64 id = 0, lat = 0, lon = 0;
+
+    while (reader.next()) {
+        switch (reader.getField()) {
+            case 1: id = reader.svarint(); break;
+            case 8: lat = reader.svarint(); break;
+            case 9: lon = reader.svarint(); break;
+            default: reader.skip();
+        }
+    }
+    if (reader.hasError()) return false;
+
+    OsmNode node = { (u64) id, block.coordinates(lat, lon) };
+    chunk.node(node);
+    return true;
+}
+
+// Ids and coordinates of dense nodes are delta-encoded
+static bool readDenseNodes(string_view message, const BlockGranularity& block, OsmChunk& chunk) {
+    ProtoReader reader(message);
+    vector<i64> ids, lats, lons;
+
+    while (reader.next()) {
+        switch (reader.getField()) {
+            case 1: reader.forEachVarint([&](u64 v) { ids.push_back(zigZagDecode(v)); }); break;
+            case 8: reader.forEachVarint([&](u64 v) { lats.push_back(zigZagDecode(v)); }); break;
+            case 9: reader.forEachVarint([&](u64 v) { lons.push_back(zigZagDecode(v)); }); break;
+            default: reader.skip();
+        }
+    }
+    if (reader.hasError() || ids.size() != lats.size() || ids.size() != lons.size()) return false;
+
+    i64 id = 0, lat = 0, lon = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        id += ids[i];
+        lat += lats[i];
+        lon += lons[i];
+
+        OsmNode node = { (u64) id, block.coordinates(lat, lon) };
+        chunk.node(node);
+    }
+    return true;
+}
+
+static bool readWay(string_view message, const vector<string_view>& strings,
+        const RoadProfile& profile, vector<u64>& wayNodes, OsmChunk& chunk) {
+    ProtoReader reader(message);
+    vector<u32> keys, values;
+    wayNodes.clear();
+    i64 ref = 0;
+
+    while (reader.next()) {
+        switch (reader.getField()) {
+            case 2: reader.forEachVarint([&](u64 v) { keys.push_back(v); }); break;
+            case 3: reader.forEachVarint([&](u64 v) { values.push_back(v); }); break;
+            case 8: reader.forEachVarint([&](u64 v) {
+                ref += zigZagDecode(v);
+                wayNodes.push_back(ref);
+            }); break;
+            default: reader.skip();
+        }
+    }
+    if (reader.hasError() || keys.size() != values.size()) return false;
+
+    WayClassification classification(profile);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] >= strings.size() || values[i] >= strings.size()) return false;
+        classification.addTag(strings[keys[i]], strings[values[i]]);
+    }
+
+    if (classification.accepted()) {
+        chunk.way(wayNodes, classification);
+    }
+    return true;
+}
+
+// Reads the nodes and ways of a PrimitiveBlock. The string table and the
+// coordinate granularity may follow the groups, so the groups are only read
+// once the whole block has been scanned.
+static bool readPrimitiveBlock(const vector<u8>& block, const RoadProfile& profile,
+        OsmChunk& chunk) {
+    ProtoReader reader(block.data(), block.data() + block.size());
+    BlockGranularity granularity;
+    vector<string_view> strings, groups;
+
+    while (reader.next()) {
+        switch (reader.getField()) {
+            case 1: {
+                ProtoReader table(reader.bytes());
+                while (table.next()) {
+                    if (table.getField() == 1) strings.push_back(table.bytes());
+                    else table.skip();
+                }
+                if (table.hasError()) return false;
+                break;
+            }
+            case 2: groups.push_back(reader.bytes()); break;
+            case 17: granularity.granularity = reader.varint(); break;
+            case 19: granularity.latOffset = reader.varint(); break;
+            case 20: granularity.lonOffset = reader.varint(); break;
+            default: reader.skip();
+        }
+    }
+    if (reader.hasError()) return false;
+
+    vector<u64> wayNodes;
+    for (string_view group : groups) {
+        ProtoReader groupReader(group);
+        bool valid = true;
+
+        while (valid && groupReader.next()) {
+            switch (groupReader.getField()) {
+                case 1: valid = readNode(groupReader.bytes(), granularity, chunk); break;
+                case 2: valid = readDenseNodes(groupReader.bytes(), granularity, chunk); break;
+                case 3: valid = readWay(groupReader.bytes(), strings, profile, wayNodes, chunk); break;
+                default: groupReader.skip();
+            }
+        }
+        if (!valid || groupReader.hasError()) return false;
+    }
+
+    return true;
+}
+
+// Splits the file into its blobs without decoding them
+static bool splitBlobs(const u8* begin, const u8* end, vector<PbfBlob>& blobs) {
+    const u8* p = begin;
+
+    while (p < end) {
+        if (end - p < 4) return false;
+        u32 headerSize = (u32) p[0] << 24 | (u32) p[1] << 16 | (u32) p[2] << 8 | p[3];
+        p += 4;
+        if (headerSize > MAX_BLOB_HEADER_SIZE || headerSize > (size_t) (end - p)) return false;
+
+        ProtoReader header(p, p + headerSize);
+        PbfBlob blob;
+        u64 dataSize = 0;
+
+        while (header.next()) {
+            switch (header.getField()) {
+                case 1: blob.type = header.bytes(); break;
+                case 3: dataSize = header.varint(); break;
+                default: header.skip();
+            }
+        }
+        p += headerSize;
+        if (header.hasError() || dataSize > MAX_BLOB_SIZE || dataSize > (size_t) (end - p)) return false;
+
+        blob.data = string_view(reinterpret_cast<const char*>(p), dataSize);
+        blobs.push_back(blob);
+        p += dataSize;
+    }
+
+    return true;
+}
+
+// Blobs are independent, so they are decompressed and decoded in parallel into
+// one chunk each, and merged in file order like the chunks of the parallel XML
+// parser
+OsmXmlData parseOsmPbf(const char* path, u32 numThreads, bool printLogs,
+        const RoadProfile& profile) {
+    OsmXmlData data;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        cerr << "Error: could not open OSM file '" << path << "'." << endl;
+        if (fd >= 0) close(fd);
+        return data;
+    }
+
+    size_t size = st.st_size;
+    void* mapping = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        cerr << "Error: could not map OSM file '" << path << "'." << endl;
+        return data;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    auto t0 = high_resolution_clock::now();
+
+    const u8* begin = static_cast<const u8*>(mapping);
+    vector<PbfBlob> blobs;
+    bool valid = splitBlobs(begin, begin + size, blobs);
+
+    vector<OsmChunk> chunks(blobs.size());
+    vector<char> decoded(blobs.size(), false);
+
+    if (valid) {
+        runParallel(blobs.size(), max(numThreads, 1u), [&](size_t i) {
+            vector<u8> block;
+            if (!decodeBlob(blobs[i].data, block)) return;
+
+            if (blobs[i].type == "OSMHeader") {
+                decoded[i] = readHeaderBlock(block, chunks[i]);
+            }
+            else if (blobs[i].type == "OSMData") {
+                decoded[i] = readPrimitiveBlock(block, profile, chunks[i]);
+            }
+            else {
+                // Unknown blob types must be ignored
+                decoded[i] = true;
+            }
+        });
+    }
+
+    munmap(mapping, size);
+
+    for (char blobDecoded : decoded) {
+        valid = valid && blobDecoded;
+    }
+    if (!valid) {
+        cerr << "Error: OSM PBF file '" << path << "' is malformed or unsupported." << endl;
+        return OsmXmlData();
+    }
+
+    auto t1 = high_resolution_clock::now();
+
+    // Extracts without a bounding box in the header use the extent of their nodes
+    bool hasBounds = false;
+    for (const OsmChunk& chunk : chunks) {
+        hasBounds = hasBounds || chunk.hasBounds;
+    }
+    if (!hasBounds) {
+        double minLat = 90, minLon = 180, maxLat = -90, maxLon = -180;
+        for (const OsmChunk& chunk : chunks) {
+            for (const OsmNode& node : chunk.nodes) {
+                minLat = min(minLat, node.coordinates.getLatitude());
+                minLon = min(minLon, node.coordinates.getLongitude());
+                maxLat = max(maxLat, node.coordinates.getLatitude());
+                maxLon = max(maxLon, node.coordinates.getLongitude());
+            }
+        }
+        data.minCoords = Coordinates(minLat, minLon);
+        data.maxCoords = Coordinates(maxLat, maxLon);
+    }
+
+    buildGraphFromChunks(data, chunks, max(numThreads, 1u), printLogs);
+
+    auto t2 = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Parsed OSM PBF (" << blobs.size() << " blocks) with " << numThreads
+            << " threads: decoding " << interval<milliseconds>(t0, t1)
+            << "ms, building graph " << interval<milliseconds>(t1, t2) << "ms\n";
+    }
+
+    return data;
+}
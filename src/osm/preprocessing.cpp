@@ -0,0 +1,503 @@
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include "preprocessing.hpp"
+#include "../algorithms/a_star.hpp"
+#include "../utils.hpp"
+
+using namespace std;
+using chrono::high_resolution_clock;
+using chrono::milliseconds;
+
+// Position of (x, y) along a Hilbert curve covering a 2^16 x 2^16 grid
+static u64 hilbertIndex(u32 x, u32 y) {
+    static const u32 n = 1 << 16;
+    u64 d = 0;
+
+    for (u32 s = n / 2; s > 0; s /= 2) {
+        u32 rx = (x & s) > 0, ry = (y & s) > 0;
+        d += (u64) s * s * ((3 * rx) ^ ry);
+
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+
+    return d;
+}
+
+static vector<u32> hilbertOrder(const OsmXmlData& data) {
+    const Graph<OsmNode>& graph = data.graph;
+    u32 n = graph.numNodes();
+
+    double minLat = data.minCoords.getLatitude(), minLon = data.minCoords.getLongitude();
+    double latSpan = data.maxCoords.getLatitude() - minLat,
+        lonSpan = data.maxCoords.getLongitude() - minLon;
+    double span = max(max(latSpan, lonSpan), 1e-9);
+
+    auto gridCoordinate = [span](double value, double min) {
+        double cell = (value - min) / span * 65535.0;
+        return (u32) clamp(cell, 0.0, 65535.0);
+    };
+
+    vector<u64> keys(n);
+    for (u32 i = 0; i < n; ++i) {
+        const Coordinates& coords = graph.getNode(i).coordinates;
+        keys[i] = hilbertIndex(
+            gridCoordinate(coords.getLongitude(), minLon),
+            gridCoordinate(coords.getLatitude(), minLat)
+        );
+    }
+
+    vector<u32> order(n);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&keys](u32 a, u32 b) {
+        return keys[a] < keys[b];
+    });
+
+    return order;
+}
+
+static vector<u32> reverseCuthillMcKeeOrder(const OsmXmlData& data) {
+    const Graph<OsmNode>& graph = data.graph;
+    u32 n = graph.numNodes();
+
+    // Breadth-first searches start from low degree nodes, which tend to be on
+    // the periphery of the network
+    vector<u32> starts(n);
+    iota(starts.begin(), starts.end(), 0);
+    stable_sort(starts.begin(), starts.end(), [&graph](u32 a, u32 b) {
+        return graph.degree(a) < graph.degree(b);
+    });
+
+    vector<u32> order;
+    order.reserve(n);
+    vector<bool> visited(n, false);
+    vector<u32> neighbors;
+
+    for (u32 start : starts) {
+        if (visited[start]) continue;
+
+        size_t head = order.size();
+        order.push_back(start);
+        visited[start] = true;
+
+        while (head < order.size()) {
+            u32 node = order[head++];
+
+            neighbors.clear();
+            for (u32 e = graph.edgesBegin(node); e != graph.edgesEnd(node); ++e) {
+                u32 target = graph.getTarget(e);
+                if (!visited[target]) {
+                    visited[target] = true;
+                    neighbors.push_back(target);
+                }
+            }
+
+            sort(neighbors.begin(), neighbors.end(), [&graph](u32 a, u32 b) {
+                return graph.degree(a) < graph.degree(b);
+            });
+            order.insert(order.end(), neighbors.begin(), neighbors.end());
+        }
+    }
+
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+vector<u32> computeNodeOrder(const OsmXmlData& data, NodeOrdering ordering) {
+    switch (ordering) {
+        case HILBERT_CURVE:
+            return hilbertOrder(data);
+        case REVERSE_CUTHILL_MCKEE:
+            return reverseCuthillMcKeeOrder(data);
+        default: {
+            vector<u32> order(data.graph.numNodes());
+            iota(order.begin(), order.end(), 0);
+            return order;
+        }
+    }
+}
+
+void reorderNodes(OsmXmlData& data, NodeOrdering ordering, bool printLogs) {
+    if (ordering == OSM_ORDER) return;
+
+    auto start = high_resolution_clock::now();
+    data.graph.renumber(computeNodeOrder(data, ordering));
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Reordered " << data.graph.numNodes() << " nodes in "
+            << interval<milliseconds>(start, end) << "ms\n";
+    }
+}
+
+// Iterative version of Tarjan's algorithm. Returns the component of each node;
+// components are numbered from 0 to numComponents - 1.
+static vector<u32> stronglyConnectedComponents(const Graph<OsmNode>& graph, u32& numComponents) {
+    static const u32 NONE = Graph<OsmNode>::INVALID_INDEX;
+    u32 n = graph.numNodes();
+
+    vector<u32> component(n, NONE), index(n, NONE), lowLink(n, 0);
+    vector<bool> onStack(n, false);
+    vector<u32> sccStack;
+    vector<pair<u32, u32>> callStack; // (node, next edge to visit)
+    u32 nextIndex = 0;
+    numComponents = 0;
+
+    for (u32 root = 0; root < n; ++root) {
+        if (index[root] != NONE) continue;
+
+        callStack.push_back({root, graph.edgesBegin(root)});
+        index[root] = lowLink[root] = nextIndex++;
+        sccStack.push_back(root);
+        onStack[root] = true;
+
+        while (!callStack.empty()) {
+            u32 v = callStack.back().first;
+            u32& e = callStack.back().second;
+
+            if (e != graph.edgesEnd(v)) {
+                u32 w = graph.getTarget(e++);
+
+                if (index[w] == NONE) {
+                    index[w] = lowLink[w] = nextIndex++;
+                    sccStack.push_back(w);
+                    onStack[w] = true;
+                    callStack.push_back({w, graph.edgesBegin(w)});
+                }
+                else if (onStack[w]) {
+                    lowLink[v] = min(lowLink[v], index[w]);
+                }
+                continue;
+            }
+
+            if (lowLink[v] == index[v]) {
+                u32 w;
+                do {
+                    w = sccStack.back();
+                    sccStack.pop_back();
+                    onStack[w] = false;
+                    component[w] = numComponents;
+                } while (w != v);
+                ++numComponents;
+            }
+
+            callStack.pop_back();
+            if (!callStack.empty()) {
+                u32 parent = callStack.back().first;
+                lowLink[parent] = min(lowLink[parent], lowLink[v]);
+            }
+        }
+    }
+
+    return component;
+}
+
+void restrictToLargestComponent(OsmXmlData& data, bool printLogs) {
+    auto start = high_resolution_clock::now();
+
+    Graph<OsmNode>& graph = data.graph;
+    u32 numComponents;
+    vector<u32> component = stronglyConnectedComponents(graph, numComponents);
+
+    vector<u32> sizes(numComponents, 0);
+    for (u32 c : component) {
+        ++sizes[c];
+    }
+    u32 largest = max_element(sizes.begin(), sizes.end()) - sizes.begin();
+
+    u32 excluded = 0;
+    for (u32 i = 0; i < graph.numNodes(); ++i) {
+        OsmNode& node = graph.getNode(i);
+        if (component[i] != largest && node.mapMatch) {
+            node.mapMatch = false;
+            ++excluded;
+        }
+    }
+
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        sort(sizes.begin(), sizes.end(), greater<u32>());
+
+        cout << "Found " << numComponents << " strongly connected components in "
+            << interval<milliseconds>(start, end) << "ms (largest sizes:";
+        for (u32 i = 0; i < min<u32>(5, numComponents); ++i) {
+            cout << " " << sizes[i];
+        }
+        cout << "), excluded " << excluded << " nodes from map matching\n";
+    }
+}
+
+OsmXmlData cropToInstance(const OsmXmlData& data, const CvrpInstance& instance,
+        double margin, bool printLogs) {
+    static const double METERS_PER_DEGREE = 111320;
+
+    auto start = high_resolution_clock::now();
+
+    vector<Coordinates> locations = {instance.getOrigin()};
+    for (const CvrpDelivery& delivery : instance.getDeliveries()) {
+        locations.push_back(delivery.coordinates);
+    }
+
+    double minLat = DBL_MAX, minLon = DBL_MAX, maxLat = -DBL_MAX, maxLon = -DBL_MAX;
+    for (const Coordinates& location : locations) {
+        minLat = min(minLat, location.getLatitude());
+        minLon = min(minLon, location.getLongitude());
+        maxLat = max(maxLat, location.getLatitude());
+        maxLon = max(maxLon, location.getLongitude());
+    }
+
+    // A degree of longitude is shortest at the latitude farthest from the equator
+    double latMargin = margin / METERS_PER_DEGREE;
+    double maxAbsLat = min(max(fabs(minLat), fabs(maxLat)) + latMargin, 89.0);
+    double lonMargin = margin / (METERS_PER_DEGREE * cos(degToRad(maxAbsLat)));
+
+    minLat = max(minLat - latMargin, data.minCoords.getLatitude());
+    minLon = max(minLon - lonMargin, data.minCoords.getLongitude());
+    maxLat = min(maxLat + latMargin, data.maxCoords.getLatitude());
+    maxLon = min(maxLon + lonMargin, data.maxCoords.getLongitude());
+
+    const Graph<OsmNode>& graph = data.graph;
+    const vector<double>& distances = graph.getDistances();
+    const vector<double>& travelTimes = graph.getTravelTimes();
+    u32 n = graph.numNodes();
+
+    GraphBuilder<OsmNode> builder;
+    vector<bool> inside(n, false);
+    for (u32 i = 0; i < n; ++i) {
+        const Coordinates& coords = graph.getNode(i).coordinates;
+        inside[i] = coords.getLatitude() >= minLat && coords.getLatitude() <= maxLat &&
+            coords.getLongitude() >= minLon && coords.getLongitude() <= maxLon;
+        if (inside[i]) builder.addNode(graph.getId(i), graph.getNode(i));
+    }
+
+    for (u32 i = 0; i < n; ++i) {
+        if (!inside[i]) continue;
+
+        for (u32 e = graph.edgesBegin(i); e != graph.edgesEnd(i); ++e) {
+            u32 target = graph.getTarget(e);
+            if (inside[target]) {
+                builder.addEdge(graph.getId(i), graph.getId(target), distances[e], travelTimes[e]);
+            }
+        }
+    }
+
+    OsmXmlData cropped;
+    cropped.graph = builder.build();
+    cropped.graph.setMetric(graph.getMetric());
+    cropped.minCoords = Coordinates(minLat, minLon);
+    cropped.maxCoords = Coordinates(maxLat, maxLon);
+    cropped.maxSpeed = data.maxSpeed;
+    cropped.edgeGeometry = data.edgeGeometry;
+
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Cropped road graph with a margin of " << margin << "m from " << n
+            << " to " << cropped.graph.numNodes() << " nodes in "
+            << interval<milliseconds>(start, end) << "ms\n";
+    }
+
+    return cropped;
+}
+
+bool spotCheckCrop(const OsmXmlData& original, const OsmXmlData& cropped,
+        const vector<u64>& nodes, bool printLogs) {
+    static const u32 NUM_SOURCES = 4;
+    static const double TOLERANCE = 1e-9;
+
+    auto start = high_resolution_clock::now();
+
+    bool valid = true;
+    u32 numSources = min<u32>(NUM_SOURCES, nodes.size());
+    SearchWorkspace workspace;
+    vector<double> expected, actual;
+    for (u32 i = 0; i < numSources && valid; ++i) {
+        u64 source = nodes[(u64) i * nodes.size() / numSources];
+        dijkstraDistances(original.graph, source, nodes, BINARY_HEAP, workspace, expected);
+        dijkstraDistances(cropped.graph, source, nodes, BINARY_HEAP, workspace, actual);
+
+        for (size_t j = 0; j < nodes.size() && valid; ++j) {
+            if (expected[j] == DBL_MAX) continue;
+
+            // Paths in the cropped graph can only be longer
+            valid = actual[j] != DBL_MAX && actual[j] <= expected[j] * (1 + TOLERANCE);
+        }
+    }
+
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Spot-checked cropped road graph from " << numSources << " sampled sources (of "
+            << nodes.size() << ") in "
+            << interval<milliseconds>(start, end) << "ms: "
+            << (valid ? "same distances" : "distances differ") << "\n";
+    }
+
+    return valid;
+}
+
+void contractDegreeTwoChains(OsmXmlData& data, const vector<u64>& keep, bool printLogs) {
+    static const u32 NONE = Graph<OsmNode>::INVALID_INDEX;
+
+    // The graph has already been contracted
+    if (!data.edgeGeometry.empty()) return;
+
+    auto start = high_resolution_clock::now();
+
+    const Graph<OsmNode>& graph = data.graph;
+    EdgeMetric metric = graph.getMetric();
+    const vector<double>& distances = graph.getDistances();
+    const vector<double>& travelTimes = graph.getTravelTimes();
+    u32 n = graph.numNodes();
+
+    vector<u32> inDegree(n, 0), inNeighbor(n, NONE);
+    for (u32 i = 0; i < n; ++i) {
+        for (u32 e = graph.edgesBegin(i); e != graph.edgesEnd(i); ++e) {
+            u32 target = graph.getTarget(e);
+            ++inDegree[target];
+            inNeighbor[target] = i;
+        }
+    }
+
+    vector<bool> protectedNode(n, false);
+    for (u64 id : keep) {
+        u32 idx = graph.getIndex(id);
+        if (idx != NONE) protectedNode[idx] = true;
+    }
+
+    // A node is interior to a chain if it only connects two other nodes: either
+    // a -> v -> b (one-way) or a <-> v <-> b (two-way)
+    vector<bool> interior(n, false);
+    for (u32 v = 0; v < n; ++v) {
+        if (protectedNode[v]) continue;
+
+        u32 outDegree = graph.degree(v);
+        if (outDegree == 1 && inDegree[v] == 1) {
+            u32 a = inNeighbor[v], b = graph.getTarget(graph.edgesBegin(v));
+            interior[v] = a != b && a != v && b != v;
+        }
+        else if (outDegree == 2 && inDegree[v] == 2) {
+            u32 a = graph.getTarget(graph.edgesBegin(v)),
+                b = graph.getTarget(graph.edgesBegin(v) + 1);
+            if (a == b || a == v || b == v) continue;
+
+            u32 inFromA = 0, inFromB = 0;
+            for (u32 u : {a, b}) {
+                for (u32 e = graph.edgesBegin(u); e != graph.edgesEnd(u); ++e) {
+                    if (graph.getTarget(e) == v) {
+                        u == a ? ++inFromA : ++inFromB;
+                    }
+                }
+            }
+            interior[v] = inFromA == 1 && inFromB == 1;
+        }
+    }
+
+    GraphBuilder<OsmNode> builder;
+    for (u32 v = 0; v < n; ++v) {
+        if (!interior[v]) builder.addNode(graph.getId(v), graph.getNode(v));
+    }
+
+    unordered_map<pair<u64, u64>, vector<OsmNode>, PairHash> edgeGeometry;
+
+    struct ContractedEdge {
+        u32 to;
+        double weight, distance, travelTime;
+        vector<OsmNode> geometry;
+    };
+    vector<ContractedEdge> edges;
+
+    for (u32 u = 0; u < n; ++u) {
+        if (interior[u]) continue;
+        edges.clear();
+
+        for (u32 e = graph.edgesBegin(u); e != graph.edgesEnd(u); ++e) {
+            ContractedEdge edge = {graph.getTarget(e), graph.getWeight(e), distances[e],
+                travelTimes[e], {}};
+            u32 prev = u;
+
+            // Follow the chain until the next node that is kept
+            while (interior[edge.to] && edge.geometry.size() < n) {
+                u32 v = edge.to;
+                edge.geometry.push_back(graph.getNode(v));
+
+                u32 next = graph.edgesBegin(v);
+                if (graph.degree(v) == 2 && graph.getTarget(next) == prev) ++next;
+
+                edge.weight += graph.getWeight(next);
+                edge.distance += distances[next];
+                edge.travelTime += travelTimes[next];
+                prev = v;
+                edge.to = graph.getTarget(next);
+            }
+
+            if (edge.to == u || interior[edge.to]) continue;
+
+            // Only the shortest of several parallel edges is ever used by a search
+            bool parallel = false;
+            for (ContractedEdge& other : edges) {
+                if (other.to == edge.to) {
+                    parallel = true;
+                    if (edge.weight < other.weight) other = move(edge);
+                    break;
+                }
+            }
+            if (!parallel) edges.push_back(move(edge));
+        }
+
+        u64 from = graph.getId(u);
+        for (ContractedEdge& edge : edges) {
+            u64 to = graph.getId(edge.to);
+            builder.addEdge(from, to, edge.distance, edge.travelTime);
+
+            if (!edge.geometry.empty()) {
+                edgeGeometry[make_pair(from, to)] = move(edge.geometry);
+            }
+        }
+    }
+
+    size_t numEdges = graph.numEdges();
+    data.graph = builder.build();
+    data.graph.setMetric(metric);
+
+    data.edgeGeometry = move(edgeGeometry);
+
+    auto end = high_resolution_clock::now();
+
+    if (printLogs) {
+        cout << "Contracted road graph from " << n << " to " << data.graph.numNodes()
+            << " nodes and from " << numEdges << " to " << data.graph.numEdges()
+            << " edges in " << interval<milliseconds>(start, end) << "ms\n";
+    }
+}
+
+list<u64> unpackPath(const OsmXmlData& data, const list<u64>& path) {
+    if (data.edgeGeometry.empty() || path.size() < 2) return path;
+
+    list<u64> unpacked;
+    auto it = path.begin();
+    unpacked.push_back(*it);
+
+    for (auto next = std::next(it); next != path.end(); ++it, ++next) {
+        auto geometry = data.edgeGeometry.find(make_pair(*it, *next));
+        if (geometry != data.edgeGeometry.end()) {
+            for (const OsmNode& node : geometry->second) {
+                unpacked.push_back(node.id);
+            }
+        }
+        unpacked.push_back(*next);
+    }
+
+    return unpacked;
+}
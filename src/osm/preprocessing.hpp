@@ -0,0 +1,48 @@
+#ifndef PREPROCESSING_H
+#define PREPROCESSING_H
+
+#include <list>
+#include <vector>
+#include "osm.hpp"
+#include "../cvrp/cvrp.hpp"
+
+enum NodeOrdering {
+    OSM_ORDER,
+    HILBERT_CURVE,
+    REVERSE_CUTHILL_MCKEE,
+};
+
+// Computes a permutation of the graph nodes (order[i] is the index of the node
+// that should be placed at position i)
+std::vector<u32> computeNodeOrder(const OsmXmlData& data, NodeOrdering ordering);
+
+// Renumbers the graph nodes so that nodes that are close to each other (in
+// space or in the graph) are also close in memory
+void reorderNodes(OsmXmlData& data, NodeOrdering ordering, bool printLogs = false);
+
+// Excludes nodes outside of the largest strongly connected component from map
+// matching, so that every pair of matched nodes is connected in both directions
+void restrictToLargestComponent(OsmXmlData& data, bool printLogs = false);
+
+// Returns the subgraph of the nodes within margin metres of the bounding box of
+// the origin and deliveries of the instance
+OsmXmlData cropToInstance(const OsmXmlData& data, const CvrpInstance& instance,
+    double margin, bool printLogs = false);
+
+// Spot check of a crop: compares the shortest path distances from a sample of
+// the given nodes to all of them in the cropped graph and in the original
+// graph. Distances from the other nodes may still be longer in the cropped
+// graph, so passing it does not make them exact.
+bool spotCheckCrop(const OsmXmlData& original, const OsmXmlData& cropped,
+    const std::vector<u64>& nodes, bool printLogs = false);
+
+// Replaces chains of nodes with a single predecessor and successor (in both
+// directions for two-way roads) by a single edge, keeping the removed nodes in
+// data.edgeGeometry. Nodes in keep are never removed. Has no effect on a graph
+// that has already been contracted.
+void contractDegreeTwoChains(OsmXmlData& data, const std::vector<u64>& keep, bool printLogs = false);
+
+// Expands a path over the contracted graph into the original OSM nodes
+std::list<u64> unpackPath(const OsmXmlData& data, const std::list<u64>& path);
+
+#endif // PREPROCESSING_H
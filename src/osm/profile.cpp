@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <json/json.hpp>
+#include "profile.hpp"
+#include "../utils.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+RoadProfile::RoadProfile() : accessTags({"access"}), deniedAccess({"no"}) {
+    setClasses({
+        {"motorway", 90}, {"motorway_link", 45}, {"trunk", 80}, {"trunk_link", 40},
+        {"primary", 60}, {"primary_link", 30}, {"secondary", 50}, {"secondary_link", 25},
+        {"tertiary", 40}, {"tertiary_link", 20}, {"unclassified", 30}, {"residential", 30},
+        {"living_street", 10}, {"service", 15}, {"road", 30},
+
+        {"pedestrian", 0}, {"track", 0}, {"escape", 0}, {"raceway", 0}, {"busway", 0},
+        {"bus_guideway", 0}, {"footway", 0}, {"bridleway", 0}, {"steps", 0},
+        {"corridor", 0}, {"path", 0}, {"cycleway", 0}, {"proposed", 0},
+        {"construction", 0}, {"elevator", 0}
+    }, 30);
+}
+
+void RoadProfile::setClasses(const vector<pair<string, double>>& classSpeeds,
+        double defaultSpeed) {
+    vector<pair<string, double>> sorted = classSpeeds;
+    sort(sorted.begin(), sorted.end());
+
+    classes.clear();
+    speeds.clear();
+    for (const auto& entry : sorted) {
+        classes.push_back(entry.first);
+        speeds.push_back(entry.second);
+    }
+    speeds.push_back(defaultSpeed);
+}
+
+// Speeds are in km/h, 0 excluding the roads
+static bool isSpeed(const json& value) {
+    return value.is_number() && value.get<double>() >= 0;
+}
+
+static bool readStrings(const json& value, vector<string>& strings) {
+    if (!value.is_array()) return false;
+
+    vector<string> result;
+    for (const json& element : value) {
+        if (!element.is_string()) return false;
+        result.push_back(element.get<string>());
+    }
+    strings = move(result);
+    return true;
+}
+
+bool RoadProfile::load(const char* path) {
+    ifstream ifs(path);
+    if (!ifs.good()) return false;
+
+    json profile = json::parse(ifs, nullptr, false);
+    if (profile.is_discarded() || !profile.is_object()) return false;
+
+    // Every field is checked before the profile is changed
+    double defaultSpeed = speeds.back();
+    if (profile.contains("default_speed")) {
+        if (!isSpeed(profile["default_speed"])) return false;
+        defaultSpeed = profile["default_speed"].get<double>();
+    }
+
+    vector<pair<string, double>> classSpeeds;
+    bool hasHighways = profile.contains("highways");
+    if (hasHighways) {
+        if (!profile["highways"].is_object()) return false;
+        for (auto& entry : profile["highways"].items()) {
+            if (!isSpeed(entry.value())) return false;
+            classSpeeds.push_back({entry.key(), entry.value().get<double>()});
+        }
+    }
+
+    vector<string> newAccessTags = accessTags, newDeniedAccess = deniedAccess;
+    if (profile.contains("access_tags") && !readStrings(profile["access_tags"], newAccessTags)) {
+        return false;
+    }
+    if (profile.contains("denied_access") &&
+            !readStrings(profile["denied_access"], newDeniedAccess)) {
+        return false;
+    }
+
+    bool newUseMaxspeed = useMaxspeed;
+    if (profile.contains("use_maxspeed")) {
+        if (!profile["use_maxspeed"].is_boolean()) return false;
+        newUseMaxspeed = profile["use_maxspeed"].get<bool>();
+    }
+
+    // The A* heuristic for travel times divides by the maximum speed
+    double newMaxSpeed = maxSpeed;
+    if (profile.contains("max_speed")) {
+        if (!profile["max_speed"].is_number()) return false;
+        newMaxSpeed = profile["max_speed"].get<double>();
+    }
+    if (!(newMaxSpeed > 0)) return false;
+
+    if (hasHighways) {
+        setClasses(classSpeeds, defaultSpeed);
+    }
+    else {
+        speeds.back() = defaultSpeed;
+    }
+    accessTags = move(newAccessTags);
+    deniedAccess = move(newDeniedAccess);
+    useMaxspeed = newUseMaxspeed;
+    maxSpeed = newMaxSpeed;
+
+    return true;
+}
+
+u32 RoadProfile::highwayClass(string_view value) const {
+    auto it = lower_bound(classes.begin(), classes.end(), value,
+        [](const string& a, string_view b) { return a < b; });
+
+    if (it != classes.end() && *it == value) return it - classes.begin();
+    return classes.size();
+}
+
+double RoadProfile::classSpeed(u32 highwayClass) const {
+    return min(speeds[highwayClass], maxSpeed);
+}
+
+bool RoadProfile::isAccessTag(string_view key) const {
+    return find(accessTags.begin(), accessTags.end(), key) != accessTags.end();
+}
+
+bool RoadProfile::deniesAccess(string_view value) const {
+    return find(deniedAccess.begin(), deniedAccess.end(), value) != deniedAccess.end();
+}
+
+bool RoadProfile::usesMaxspeedTag() const {
+    return useMaxspeed;
+}
+
+double RoadProfile::getMaxSpeed() const {
+    return maxSpeed;
+}
+
+u64 RoadProfile::fingerprint() const {
+    size_t seed = 0;
+    for (size_t i = 0; i < classes.size(); ++i) {
+        hashCombine(seed, classes[i], speeds[i]);
+    }
+    hashCombine(seed, speeds.back(), useMaxspeed, maxSpeed);
+    for (const string& tag : accessTags) {
+        hashCombine(seed, tag);
+    }
+    hashCombine(seed, string("|"));
+    for (const string& value : deniedAccess) {
+        hashCombine(seed, value);
+    }
+    return seed;
+}
+
+double parseMaxspeed(string_view value) {
+    double speed = 0;
+    auto result = from_chars(value.data(), value.data() + value.size(), speed);
+    if (result.ec != errc()) return 0;
+
+    string_view unit(result.ptr, value.data() + value.size() - result.ptr);
+    while (!unit.empty() && unit.front() == ' ') unit.remove_prefix(1);
+
+    if (unit == "mph") return speed * 1.609344;
+    if (unit.empty() || unit == "km/h" || unit == "kmh") return speed;
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../types.hpp"
+
+// Decides which ways belong to the road network and how fast they can be
+// driven. Highway classes are kept in a sorted table so that tags can be
+// classified during parsing without allocating.
+class RoadProfile {
+    public:
+        // Accepts every highway class except those used by pedestrians,
+        // cyclists and public transport, with typical urban car speeds
+        RoadProfile();
+
+        // Reads a JSON profile. Fields missing from the file keep the values of
+        // the default profile. Returns false, leaving the profile untouched, if
+        // the file cannot be read, a field has the wrong type, a speed is
+        // negative or the maximum speed is not positive.
+        bool load(const char* path);
+
+        // Index of a highway class, used with classSpeed
+        u32 highwayClass(std::string_view value) const;
+
+        // Speed in km/h, 0 if the class is not allowed
+        double classSpeed(u32 highwayClass) const;
+
+        bool isAccessTag(std::string_view key) const;
+        bool deniesAccess(std::string_view value) const;
+
+        bool usesMaxspeedTag() const;
+
+        // Upper bound on the speed of every edge, in km/h
+        double getMaxSpeed() const;
+
+        // Identifies the profile in graph caches
+        u64 fingerprint() const;
+    private:
+        // Sorted highway classes; speeds has one more entry for unlisted classes
+        std::vector<std::string> classes;
+        std::vector<double> speeds;
+
+        std::vector<std::string> accessTags;
+        std::vector<std::string> deniedAccess;
+
+        bool useMaxspeed = true;
+        double maxSpeed = 130;
+
+        void setClasses(const std::vector<std::pair<std::string, double>>& classSpeeds,
+            double defaultSpeed);
+};
+
+// Parses the value of a maxspeed tag ("50", "30 mph"), returning 0 if it is
+// not a number
+double parseMaxspeed(std::string_view value);
+
+#endif // PROFILE_H
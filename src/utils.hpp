@@ -2,11 +2,18 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <numeric>
 #include <random>
 #include <ostream>
+#include <thread>
+#include <vector>
 
 #include "types.hpp"
 
@@ -24,6 +31,119 @@ u64 interval(const std::chrono::high_resolution_clock::time_point& start,
     return std::chrono::duration_cast<T>(end - start).count();
 }
 
+// Runs job(i) for every i in [0, numJobs) using numThreads threads
+template <typename Job>
+void runParallel(size_t numJobs, u32 numThreads, Job job) {
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+
+    for (u32 t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = next++; i < numJobs; i = next++) {
+                job(i);
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+// Runs job(order[i], thread) for every i using numThreads threads, for jobs
+// whose costs vary a lot. The jobs are split into chunks of chunkSize, which
+// are dealt to the threads in turn, so if order starts with the longest jobs
+// every thread starts with its longest ones. A thread takes chunks from the
+// front of its own deque and, when it runs out, steals from the back of the
+// others'. thread is in [0, numThreads), for per-thread state.
+template <typename Job>
+void runWorkStealing(const std::vector<size_t>& order, u32 numThreads, size_t chunkSize,
+        Job job) {
+    struct Chunk {
+        size_t begin, end;
+    };
+    struct WorkerDeque {
+        std::mutex mut;
+        std::deque<Chunk> chunks;
+    };
+
+    numThreads = std::max(numThreads, 1u);
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    std::vector<WorkerDeque> deques(numThreads);
+
+    for (size_t begin = 0, c = 0; begin < order.size(); begin += chunkSize, ++c) {
+        deques[c % numThreads].chunks.push_back({begin, std::min(begin + chunkSize, order.size())});
+    }
+
+    auto takeChunk = [&](u32 thread, Chunk& chunk) {
+        for (u32 i = 0; i < numThreads; ++i) {
+            WorkerDeque& d = deques[(thread + i) % numThreads];
+            std::lock_guard<std::mutex> lock(d.mut);
+            if (d.chunks.empty()) continue;
+
+            if (i == 0) {
+                chunk = d.chunks.front();
+                d.chunks.pop_front();
+            }
+            else {
+                chunk = d.chunks.back();
+                d.chunks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    };
+
+    // No chunks are added once the threads start, so a thread that finds
+    // every deque empty is done
+    std::vector<std::thread> threads;
+    for (u32 t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t] {
+            Chunk chunk;
+            while (takeChunk(t, chunk)) {
+                for (size_t i = chunk.begin; i < chunk.end; ++i) {
+                    job(order[i], t);
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+// Same as above for the jobs 0 to numJobs - 1, in that order
+template <typename Job>
+void runWorkStealing(size_t numJobs, u32 numThreads, size_t chunkSize, Job job) {
+    std::vector<size_t> order(numJobs);
+    std::iota(order.begin(), order.end(), 0);
+    runWorkStealing(order, numThreads, chunkSize, job);
+}
+
+// Blocks each of numThreads threads calling wait until all of them have, and
+// can then be reused for the next phase
+class Barrier {
+    public:
+        explicit Barrier(u32 numThreads) : numThreads(numThreads) {}
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mut);
+            u64 phase = currentPhase;
+            if (++waiting == numThreads) {
+                waiting = 0;
+                ++currentPhase;
+                cond.notify_all();
+            }
+            else {
+                cond.wait(lock, [&] { return currentPhase != phase; });
+            }
+        }
+    private:
+        std::mutex mut;
+        std::condition_variable cond;
+        u32 numThreads, waiting = 0;
+        u64 currentPhase = 0;
+};
+
 class AtomicOStream {
     public:
         AtomicOStream(std::ostream& os) : os(os) {}